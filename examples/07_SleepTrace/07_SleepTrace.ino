@@ -0,0 +1,62 @@
+/** This example uses the sleep trace to measure how much time is spent awake
+ *   during a deeplyFor(), and so the duty cycle of your chip.
+ *
+ *  Tracing is compiled into the library only when SS_TRACE is 1, set it in
+ *   SimpleSleep's src/avr/avr.h (or add -DSS_TRACE=1 to your build flags).
+ *
+ *  For each sleep time we print how many times the chip woke up, how many
+ *   microseconds it was awake for during the deeplyFor() and the resulting
+ *   duty cycle in parts per million.  Timer0 does not run while sleeping
+ *   deeply, so micros() only counts the time awake.
+ *
+ *  For cycle exact numbers on each chip see extras/simavr (run.sh bench).
+ *
+ *  The raw trace for the last deeplyFor() is dumped too, see
+ *   SimpleSleep::dumpTrace() for the columns.
+ */
+
+#include <SimpleSleep.h>
+
+SimpleSleep Sleep;
+
+const uint32_t sleepTimes[] = { 15, 100, 1000, 8000 };
+
+void setup()
+{
+  Serial.begin(9600);
+}
+
+void loop()
+{
+  #if SS_TRACE
+    for(uint8_t i = 0; i < sizeof(sleepTimes)/sizeof(sleepTimes[0]); i++)
+    {
+      Serial.flush();
+      Sleep.clearTrace();
+
+      uint32_t awakeUs = micros();
+      Sleep.deeplyFor(sleepTimes[i]);
+      awakeUs = micros() - awakeUs;
+
+      SimpleSleep_TraceEvent events[SS_TRACE_SIZE];
+      uint8_t count = Sleep.getTrace(events, SS_TRACE_SIZE);
+
+      Serial.print(F("deeplyFor("));
+      Serial.print(sleepTimes[i]);
+      Serial.print(F(") wakeups: "));
+      Serial.print(count);
+      Serial.print(F(" awake uS: "));
+      Serial.print(awakeUs);
+      Serial.print(F(" duty ppm: "));
+      Serial.println((float)awakeUs * 1000 / sleepTimes[i]);
+    }
+
+    Sleep.dumpTrace(Serial);
+    Serial.println();
+  #else
+    Serial.println(F("Set SS_TRACE to 1 in SimpleSleep's src/avr/avr.h to use this example."));
+    Serial.flush();
+  #endif
+
+  Sleep.deeplyFor(5000);
+}
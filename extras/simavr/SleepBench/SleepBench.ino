@@ -0,0 +1,31 @@
+/** Benchmark for the simavr harness (run.sh bench).
+ *
+ *  Each deeplyFor() is bracketed by PB0 going high and low again, simsleep 
+ *   counts the cycles spent awake and the wakeups in between.  The sleep times 
+ *   here must match the labels given to simsleep in run.sh.
+ *
+ *  PB0 is driven directly so that it is the same pin on every chip.
+ */
+
+#include <SimpleSleep.h>
+
+SimpleSleep Sleep;
+
+const uint32_t sleepTimes[] = { 15, 100, 1000, 8000 };
+
+void setup()
+{
+  DDRB |= _BV(0);
+}
+
+void loop()
+{
+  for(uint8_t i = 0; i < sizeof(sleepTimes)/sizeof(sleepTimes[0]); i++)
+  {
+    PORTB |= _BV(0);
+    Sleep.deeplyFor(sleepTimes[i]);
+    PORTB &= ~_BV(0);
+  }
+  
+  Sleep.forever();
+}
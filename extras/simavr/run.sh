@@ -0,0 +1,136 @@
+#!/bin/bash
+
+# Build the SimpleSleep examples for each chip and run them under simavr, checking
+#  how they sleep, see README.md here.
+#
+#   ./run.sh          build everything and run the tests, also written to results.txt
+#   ./run.sh bench    build the benchmark and write benchmarks.csv
+#
+# Needs arduino-cli (with the cores below installed), simavr (libsimavr and its
+#  headers) and libelf.  Any of the below can be overridden from the environment.
+
+cd "$(dirname "$0")"
+
+LIBRARY="$(cd ../.. && pwd)"
+BUILD="build"
+
+ARDUINO_CLI="${ARDUINO_CLI:-arduino-cli}"
+SIMAVR_CFLAGS="${SIMAVR_CFLAGS:-$(pkg-config --cflags simavr 2>/dev/null || echo -I/usr/include/simavr)}"
+SIMAVR_LIBS="${SIMAVR_LIBS:-$(pkg-config --libs simavr 2>/dev/null || echo -lsimavr) -lelf}"
+
+CHIPS="${CHIPS:-atmega328p attiny85 attiny84 attiny13}"
+
+FQBN_atmega328p="${FQBN_atmega328p:-arduino:avr:uno}"
+FQBN_attiny85="${FQBN_attiny85:-ATTinyCore:avr:attinyx5:chip=85,clock=8internal}"
+FQBN_attiny84="${FQBN_attiny84:-ATTinyCore:avr:attinyx4:chip=84,clock=8internal}"
+FQBN_attiny13="${FQBN_attiny13:-MicroCore:avr:13}"
+
+FREQ_atmega328p="${FREQ_atmega328p:-16000000}"
+FREQ_attiny85="${FREQ_attiny85:-8000000}"
+FREQ_attiny84="${FREQ_attiny84:-8000000}"
+FREQ_attiny13="${FREQ_attiny13:-9600000}"
+
+# Light sleep is Extended Standby where there is one, else ADC Noise Reduction
+LIGHT_atmega328p="xstandby"
+LIGHT_attiny85="adc"
+LIGHT_attiny84="adc"
+LIGHT_attiny13="adc"
+
+FAILED=0
+
+# build <chip> <sketch dir> <output dir> [extra compiler flags]
+function build () {
+  local fqbn="FQBN_$1"
+  if ! "$ARDUINO_CLI" compile --fqbn "${!fqbn}" --library "$LIBRARY" --output-dir "$3" \
+        --build-property "compiler.cpp.extra_flags=$4" "$2" >"$3.log" 2>&1
+  then
+    echo "FAIL $1 $(basename "$2") did not build, see $3.log"
+    FAILED=1
+    return 1
+  fi
+}
+
+# simulate <chip> <elf> [simsleep options]
+function simulate () {
+  local chip="$1" elf="$2" freq="FREQ_$1"
+  shift 2
+  ./simsleep -m "$chip" -f "${!freq}" "$@" "$elf"
+}
+
+# expect <chip> <example> simsleep options for checking that example
+function expect () {
+  local chip="$1" example="$2"
+  local light="LIGHT_$1"
+  local led=""
+
+  # Only the ATMega has the examples' LED (pin 13, PB5)
+  if [ "$chip" == "atmega328p" ]
+  then
+    led="-P B:5:1000:10"
+  fi
+
+  case "$example" in
+    01_HelloWorld)     echo "-s 1 -M pd -W none -n 1 -F" ;;
+    02_Blink)          echo "-s 10 -M pd -W wdt -n 9 -L 1100 $led" ;;
+    03_CalibratedBlink) echo "-s 10 -M idle -M pd -R idle -R pd -W wdt -W timer0 -L 1100 $led" ;;
+    04_SleepLevels)    echo "-s 22 -M idle -M pd -M ${!light} -R idle -R pd -R ${!light} -L 4200" ;;
+    05_SleepySerial)   echo "-s 2 -M idle -W timer0 -W other -n 100" ;;
+    06_WakeInterrupt)
+      # INT0 is pin 2 on the ATMega (PD2) and ATTinyX5 (PB2), elsewhere pin 2 is not an interrupt
+      case "$chip" in
+        atmega328p) echo "-s 2 -M pd -W int0 -n 2 -H D:2 -T D:2:500" ;;
+        attiny85)   echo "-s 2 -M pd -W int0 -n 2 -H B:2 -T B:2:500" ;;
+        *)          echo "-s 2 -M pd -W none -n 1" ;;
+      esac
+      ;;
+    07_SleepTrace)     echo "-s 20 -R pd -L 8300" ;;
+    *)                 echo "-s 5" ;;
+  esac
+}
+
+mkdir -p "$BUILD"
+if ! cc -O2 -o simsleep simsleep.c $SIMAVR_CFLAGS $SIMAVR_LIBS
+then
+  echo "Unable to build simsleep, is simavr installed?"
+  exit 1
+fi
+
+if [ "$1" == "bench" ]
+then
+  # Awake cycles and wakeups inside deeplyFor()
+  echo "chip,sleepMs,wakeups,awakeCycles,awakeCyclesPerWakeup,elapsedMs,dutyPpm" >benchmarks.csv
+  for chip in $CHIPS
+  do
+    out="$BUILD/$chip/SleepBench"
+    mkdir -p "$out"
+    build "$chip" SleepBench "$out" || continue
+    simulate "$chip" "$out/SleepBench.ino.elf" -s 20 -F -B B:0:15,100,1000,8000 >>benchmarks.csv
+  done
+
+  cat benchmarks.csv
+  exit $FAILED
+fi
+
+# Keep the results to be committed
+exec > >(tee results.txt)
+
+for chip in $CHIPS
+do
+  for sketch in "$LIBRARY"/examples/*/
+  do
+    example="$(basename "$sketch")"
+    out="$BUILD/$chip/$example"
+    mkdir -p "$out"
+    build "$chip" "$sketch" "$out" || continue
+
+    if simulate "$chip" "$out/$example.ino.elf" $(expect "$chip" "$example")
+    then
+      echo "PASS $chip $example"
+    else
+      echo "FAIL $chip $example"
+      FAILED=1
+    fi
+  done
+done
+
+exit $FAILED
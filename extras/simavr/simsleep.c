@@ -0,0 +1,527 @@
+/** Runs a SimpleSleep sketch under simavr and checks how it sleeps.
+ *
+ *  Every SLEEP the firmware executes is recorded with the sleep mode it was
+ *   entered in, how long (in simulated time) it lasted and which interrupt woke
+ *   it, then checked against the expectations given on the command line.
+ *
+ *  simavr keeps clocking the timers in every sleep mode, but the real chip halts
+ *   the IO clock in all but Idle, so Timer0 (millis()) is stopped here for those
+ *   sleeps as it would be, else it would wake every Power Down within a millisecond.
+ *
+ *  Whatever is expected, these are always checked
+ *
+ *   - SE is set when SLEEP executes (simavr itself sleeps whether it is or not)
+ *   - interrupts are enabled when SLEEP executes, unless -F (forever) allows not
+ *   - where the BOD was disabled for the sleep, SLEEP followed the timed BODS
+ *     write within 3 cycles (else the BOD stays on)
+ *
+ *  Usage: simsleep -m mcu -f hz [options] firmware.elf
+ *
+ *   -s seconds    simulated time to run for (default 10)
+ *   -M mode       every sleep must be in this mode, repeat to allow several
+ *   -R mode       this mode must be slept in at least once, may repeat
+ *                   modes: idle adc pd ps standby xstandby
+ *   -W source     every wake must be by this source, repeat to allow several
+ *                   sources: wdt timer0 int0 pcint other, or none for no wakes
+ *   -n count      at least this many sleeps
+ *   -L ms         no sleep may last longer than this, catches lost wakeups
+ *   -F            the last sleep may be with interrupts off (forever)
+ *   -P port:bit:ms:percent
+ *                 the pin must toggle every ms, within percent
+ *   -B port:bit:label,label,...
+ *                 benchmark, for each time the pin goes high and then low again
+ *                   print a CSV line of what happened in between, labelled in
+ *                   turn from the list
+ *   -H port:bit   drive this input pin high (eg an interrupt pin with a pullup)
+ *   -T port:bit:ms
+ *                 drive this input pin low for 20ms at ms, and high again
+ *   -v            print every sleep
+ *
+ *  Exits 0 if everything checked out, 1 if not, 2 for a usage error.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_io.h"
+#include "sim_irq.h"
+#include "sim_interrupts.h"
+#include "avr_ioport.h"
+
+#define MAX_LIST 16
+#define OP_SLEEP 0x9588
+
+/** What we need to know about each chip, addresses are data space. */
+
+struct chip
+{
+  const char *mcu;
+  uint16_t    smcr;        // Register holding SE and the SM bits
+  uint8_t     se;          // SE bit mask
+  uint8_t     smShift;     // SM bits, shifted down and masked
+  uint8_t     smMask;
+  const char *modes[8];    // Mode names for each SM value
+  uint16_t    mcucr;       // Register holding BODS/BODSE, 0 if none
+  uint8_t     bods;
+  uint8_t     bodse;
+  uint16_t    tccr0b;      // Timer0 clock select register (CS02:0)
+  uint8_t     wdtVector;
+  uint8_t     timer0Vector; // Timer0 overflow, which is what millis() runs on
+  uint8_t     int0Vector;
+  uint8_t     pcintFirst;
+  uint8_t     pcintLast;
+};
+
+static const struct chip chips[] =
+{
+  // SMCR (0x53) SM2:0 at bits 3:1, BODS/BODSE in MCUCR (0x55) bits 6/5, TCCR0B at 0x45
+  { "atmega328p", 0x53, 0x01, 1, 7, { "idle", "adc", "pd", "ps", "?", "?", "standby", "xstandby" },
+    0x55, 0x40, 0x20, 0x45, 6, 16, 1, 3, 5 },
+
+  // MCUCR (0x55) SE bit 5, SM1:0 at bits 4:3, BODS bit 7, BODSE bit 2, TCCR0B at 0x53
+  { "attiny85",   0x55, 0x20, 3, 3, { "idle", "adc", "pd", "?" },
+    0x55, 0x80, 0x04, 0x53, 12, 5, 1, 2, 2 },
+  { "attiny84",   0x55, 0x20, 3, 3, { "idle", "adc", "pd", "?" },
+    0x55, 0x80, 0x04, 0x53, 4, 11, 1, 2, 3 },
+  { "attiny13",   0x55, 0x20, 3, 3, { "idle", "adc", "pd", "?" },
+    0x55, 0x80, 0x04, 0x53, 8, 3, 1, 2, 2 },
+};
+
+static const struct chip *chip;
+static avr_t *avr;
+static int    failed = 0;
+
+static void fail(const char *fmt, const char *what, double at)
+{
+  printf("FAIL at %.3fms: ", at);
+  printf(fmt, what);
+  printf("\n");
+  failed = 1;
+}
+
+static double ms(avr_cycle_count_t cycles)
+{
+  return (double)cycles * 1000.0 / avr->frequency;
+}
+
+static int in_list(const char *name, const char **list, int count)
+{
+  for(int x = 0; x < count; x++)
+  {
+    if(!strcmp(name, list[x])) return 1;
+  }
+  return 0;
+}
+
+static const char *wake_source(uint8_t vector)
+{
+  if(vector == chip->wdtVector)    return "wdt";
+  if(vector == chip->timer0Vector) return "timer0";
+  if(vector == chip->int0Vector)   return "int0";
+  if(vector >= chip->pcintFirst && vector <= chip->pcintLast) return "pcint";
+  return "other";
+}
+
+/** The first interrupt vectored to since SLEEP, which is what woke it, -1 if none yet.
+ *
+ *  simavr raises the AVR_INT_ANY running IRQ with the vector number as each interrupt
+ *   is entered (and 0 on RETI), which is more reliable than decoding the PC.
+ */
+
+static int asleep     = 0;
+static int wakeVector = -1;
+
+static void interrupt_running(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+  (void)irq; (void)param;
+  if(asleep && value && wakeVector < 0)
+  {
+    wakeVector = value;
+  }
+}
+
+/** Write an IO register as the firmware would, so the peripheral sees it */
+
+static void io_write(avr_io_addr_t addr, uint8_t v)
+{
+  uint8_t io = AVR_DATA_TO_IO(addr);
+  if(avr->io[io].w.c)
+  {
+    avr->io[io].w.c(avr, addr, v, avr->io[io].w.param);
+  }
+  else
+  {
+    avr->data[addr] = v;
+  }
+}
+
+/** The cycle of the last timed BODS write (BODS set, BODSE clear), 0 if none pending */
+
+static avr_cycle_count_t bodsAt = 0;
+
+static void mcucr_write(struct avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param)
+{
+  (void)param;
+  if((v & chip->bods) && !(v & chip->bodse))
+  {
+    bodsAt = avr->cycle;
+  }
+  avr_core_watch_write(avr, addr, v);
+}
+
+/** Pin toggle period checking, -P */
+
+static avr_cycle_count_t periodLast = 0;
+static int    periodCount = 0;
+static double periodMs, periodPercent;
+
+static void period_pin(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+  (void)irq; (void)value; (void)param;
+
+  // The first toggle only starts the timing
+  if(periodCount++)
+  {
+    double t = ms(avr->cycle - periodLast);
+    if(t < periodMs * (1 - periodPercent / 100) || t > periodMs * (1 + periodPercent / 100))
+    {
+      char buf[64];
+      snprintf(buf, sizeof(buf), "%.3fms", t);
+      fail("pin toggled after %s", buf, ms(avr->cycle));
+    }
+  }
+  periodLast = avr->cycle;
+}
+
+/** Benchmark spans, -B */
+
+static char  *benchLabels[MAX_LIST];
+static int    benchLabelCount = 0;
+static int    benchSpan = 0;
+static int    benchOpen = 0;
+static avr_cycle_count_t benchStart, benchAwake, awakeCycles;
+static int    benchWakes, wakes;
+
+static void bench_pin(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+  (void)irq; (void)param;
+
+  if(value && !benchOpen)
+  {
+    benchOpen  = 1;
+    benchStart = avr->cycle;
+    benchAwake = awakeCycles;
+    benchWakes = wakes;
+  }
+  else if(!value && benchOpen)
+  {
+    benchOpen = 0;
+
+    avr_cycle_count_t elapsed = avr->cycle - benchStart;
+    avr_cycle_count_t awake   = awakeCycles - benchAwake;
+    int wokeUp = wakes - benchWakes;
+
+    // chip,label,wakeups,awake cycles,awake cycles per wakeup,elapsed ms,duty ppm
+    printf("%s,%s,%d,%llu,%llu,%.3f,%.1f\n",
+      chip->mcu,
+      benchSpan < benchLabelCount ? benchLabels[benchSpan] : "?",
+      wokeUp,
+      (unsigned long long)awake,
+      (unsigned long long)(wokeUp ? awake / wokeUp : awake),
+      ms(elapsed),
+      elapsed ? (double)awake * 1000000.0 / elapsed : 0);
+
+    benchSpan++;
+  }
+}
+
+static avr_irq_t *pin_irq(const char *spec)
+{
+  avr_irq_t *irq = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(spec[0]), atoi(spec + 2));
+  if(!irq)
+  {
+    fprintf(stderr, "No such pin %s\n", spec);
+    exit(2);
+  }
+  return irq;
+}
+
+int main(int argc, char **argv)
+{
+  const char *mcu = NULL;
+  uint32_t    freq = 0;
+  double      seconds = 10;
+  const char *allowModes[MAX_LIST];   int allowModeCount = 0;
+  const char *requireModes[MAX_LIST]; int requireModeCount = 0;
+  int         requireModeSeen[MAX_LIST] = { 0 };
+  const char *allowWakes[MAX_LIST];   int allowWakeCount = 0;
+  int         minSleeps = 0;
+  double      maxSleepMs = 0;
+  int         forever = 0;
+  const char *periodSpec = NULL;
+  char       *benchSpec = NULL;
+  const char *highSpec = NULL;
+  const char *pulseSpec = NULL;
+  double      pulseMs = 0;
+  int         verbose = 0;
+
+  int opt;
+  while((opt = getopt(argc, argv, "m:f:s:M:R:W:n:L:FP:B:H:T:v")) != -1)
+  {
+    switch(opt)
+    {
+      case 'm': mcu = optarg; break;
+      case 'f': freq = strtoul(optarg, NULL, 10); break;
+      case 's': seconds = atof(optarg); break;
+      case 'M': if(allowModeCount < MAX_LIST) allowModes[allowModeCount++] = optarg; break;
+      case 'R': if(requireModeCount < MAX_LIST) requireModes[requireModeCount++] = optarg; break;
+      case 'W': if(allowWakeCount < MAX_LIST) allowWakes[allowWakeCount++] = optarg; break;
+      case 'n': minSleeps = atoi(optarg); break;
+      case 'L': maxSleepMs = atof(optarg); break;
+      case 'F': forever = 1; break;
+      case 'P': periodSpec = optarg; break;
+      case 'B': benchSpec = optarg; break;
+      case 'H': highSpec = optarg; break;
+      case 'T': pulseSpec = optarg; pulseMs = atof(strrchr(optarg, ':') + 1); break;
+      case 'v': verbose = 1; break;
+      default:  return 2;
+    }
+  }
+
+  if(!mcu || !freq || optind >= argc)
+  {
+    fprintf(stderr, "Usage: %s -m mcu -f hz [options] firmware.elf\n", argv[0]);
+    return 2;
+  }
+
+  for(size_t x = 0; x < sizeof(chips) / sizeof(chips[0]); x++)
+  {
+    if(!strcmp(chips[x].mcu, mcu)) chip = &chips[x];
+  }
+  if(!chip)
+  {
+    fprintf(stderr, "Unknown mcu %s\n", mcu);
+    return 2;
+  }
+
+  elf_firmware_t f;
+  memset(&f, 0, sizeof(f));
+  if(elf_read_firmware(argv[optind], &f))
+  {
+    fprintf(stderr, "Unable to load %s\n", argv[optind]);
+    return 2;
+  }
+  strncpy(f.mmcu, mcu, sizeof(f.mmcu) - 1);
+  f.frequency = freq;
+
+  avr = avr_make_mcu_by_name(f.mmcu);
+  if(!avr)
+  {
+    fprintf(stderr, "simavr does not know %s\n", mcu);
+    return 2;
+  }
+  avr_init(avr);
+  avr_load_firmware(avr, &f);
+  avr->log = LOG_ERROR;
+
+  if(chip->mcucr)
+  {
+    avr_register_io_write(avr, chip->mcucr, mcucr_write, NULL);
+  }
+
+  if(periodSpec)
+  {
+    if(sscanf(periodSpec + 2, "%*d:%lf:%lf", &periodMs, &periodPercent) != 2)
+    {
+      fprintf(stderr, "Bad -P %s\n", periodSpec);
+      return 2;
+    }
+    avr_irq_register_notify(pin_irq(periodSpec), period_pin, NULL);
+  }
+
+  if(benchSpec)
+  {
+    char *labels = strchr(benchSpec + 2, ':');
+    if(labels)
+    {
+      for(char *l = strtok(labels + 1, ","); l && benchLabelCount < MAX_LIST; l = strtok(NULL, ","))
+      {
+        benchLabels[benchLabelCount++] = l;
+      }
+    }
+    avr_irq_register_notify(pin_irq(benchSpec), bench_pin, NULL);
+  }
+
+  if(highSpec)
+  {
+    avr_raise_irq(pin_irq(highSpec), 1);
+  }
+
+  avr_irq_t *pulse = pulseSpec ? pin_irq(pulseSpec) : NULL;
+  avr_cycle_count_t pulseAt  = (avr_cycle_count_t)(pulseMs * freq / 1000);
+  avr_cycle_count_t pulseEnd = pulseAt + freq / 50;
+
+  avr_cycle_count_t limit   = (avr_cycle_count_t)(seconds * freq);
+  avr_cycle_count_t sleptAt = 0;
+  avr_cycle_count_t wokeAt  = 0;
+  int sleeps = 0;
+  int woken  = 0;
+  int state  = avr->state;
+  const char *mode = "?";
+  uint8_t timer0Cs = 0;
+
+  avr_irq_register_notify(avr_get_interrupt_irq(avr, AVR_INT_ANY) + AVR_INT_IRQ_RUNNING, interrupt_running, NULL);
+
+  while(avr->cycle < limit)
+  {
+    avr_cycle_count_t before = avr->cycle;
+    int wasState = state;
+
+    if(pulse && before >= pulseAt)
+    {
+      avr_raise_irq(pulse, before >= pulseEnd);
+      if(before >= pulseEnd) pulse = NULL;
+    }
+
+    // simavr executes SLEEP and the first stretch of the sleep in one avr_run(), so 
+    //  the sleep is caught here, before the SLEEP instruction runs, to check and time it
+    int sleeping = wasState == cpu_Running
+      && (avr->flash[avr->pc] | (avr->flash[avr->pc + 1] << 8)) == OP_SLEEP;
+
+    if(sleeping)
+    {
+      uint8_t smcr = avr->data[chip->smcr];
+      mode    = chip->modes[(smcr >> chip->smShift) & chip->smMask];
+      sleptAt = before + 1;
+      sleeps++;
+      asleep     = 1;
+      woken      = 0;
+      wakeVector = -1;
+
+      if(!(smcr & chip->se))
+      {
+        fail("slept in %s without SE set", mode, ms(before));
+      }
+
+      if(!avr->sreg[S_I] && !forever)
+      {
+        fail("slept in %s with interrupts disabled", mode, ms(before));
+      }
+
+      if(bodsAt && before - bodsAt > 3)
+      {
+        fail("slept in %s too long after BODS was written, the BOD was still on", mode, ms(before));
+      }
+      bodsAt = 0;
+
+      if(allowModeCount && !in_list(mode, allowModes, allowModeCount))
+      {
+        fail("slept in %s which is not expected", mode, ms(before));
+      }
+
+      for(int x = 0; x < requireModeCount; x++)
+      {
+        if(!strcmp(mode, requireModes[x])) requireModeSeen[x] = 1;
+      }
+
+      // Stop Timer0 for any sleep but idle, as the chip would
+      if(strcmp(mode, "idle") && (avr->data[chip->tccr0b] & 7))
+      {
+        timer0Cs = avr->data[chip->tccr0b];
+        io_write(chip->tccr0b, timer0Cs & ~7);
+      }
+    }
+
+    state = avr_run(avr);
+
+    if(sleeping && state != cpu_Running)
+    {
+      // Only the SLEEP instruction, the rest of this avr_run() was asleep
+      awakeCycles += 1;
+    }
+    else if(wasState == cpu_Running || state == cpu_Running)
+    {
+      // Awake, or woken up and vectored to the interrupt which did it
+      awakeCycles += avr->cycle - before;
+    }
+
+    if(state == cpu_Done)
+    {
+      if(sleeping && verbose) printf("%.3fms sleep %s, interrupts off, forever\n", ms(sleptAt), mode);
+      asleep = 0;
+      break;
+    }
+
+    // Woken up (or SLEEP did not sleep, there was an interrupt waiting)
+    if(asleep && !woken && state == cpu_Running)
+    {
+      woken  = 1;
+      wokeAt = sleeping ? sleptAt : before;
+
+      if(timer0Cs)
+      {
+        io_write(chip->tccr0b, avr->data[chip->tccr0b] | (timer0Cs & 7));
+        timer0Cs = 0;
+      }
+    }
+
+    // Once the interrupt which woke it has been vectored to
+    if(woken && wakeVector >= 0)
+    {
+      const char *source = wake_source(wakeVector);
+      double slept = ms(wokeAt - sleptAt);
+      asleep = 0;
+      woken  = 0;
+      wakes++;
+
+      if(verbose) printf("%.3fms sleep %s for %.3fms, woken by %s\n", ms(sleptAt), mode, slept, source);
+
+      if(allowWakeCount && !in_list(source, allowWakes, allowWakeCount))
+      {
+        fail("woken by %s which is not expected", source, ms(wokeAt));
+      }
+
+      if(maxSleepMs && slept > maxSleepMs)
+      {
+        fail("slept in %s for longer than expected, lost wakeup?", mode, ms(wokeAt));
+      }
+    }
+
+    if(state == cpu_Crashed)
+    {
+      fail("the firmware crashed%s", "", ms(avr->cycle));
+      break;
+    }
+  }
+
+  if(asleep && !woken && maxSleepMs && ms(avr->cycle - sleptAt) > maxSleepMs)
+  {
+    fail("still asleep in %s for longer than expected, lost wakeup?", mode, ms(avr->cycle));
+  }
+
+  if(sleeps < minSleeps)
+  {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%d", sleeps);
+    fail("only slept %s times", buf, ms(avr->cycle));
+  }
+
+  for(int x = 0; x < requireModeCount; x++)
+  {
+    if(!requireModeSeen[x])
+    {
+      fail("never slept in %s", requireModes[x], ms(avr->cycle));
+    }
+  }
+
+  if(periodSpec && periodCount < 3)
+  {
+    fail("the pin %s did not toggle enough to check its period", periodSpec, ms(avr->cycle));
+  }
+
+  return failed;
+}
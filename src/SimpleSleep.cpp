@@ -1,3 +1,96 @@
 #include "SimpleSleep.h"
 
-/* Empty File */
\ No newline at end of file
+/** This file contains the sleep hook registry, which is common to all architectures.
+ *
+ *  Hooks are kept sorted by priority as they are added so that running them is just
+ *  a walk through the array, forwards to enter and backwards to exit.
+ */
+
+bool SimpleSleep::addHook(SimpleSleep_HookFunction enter, SimpleSleep_HookFunction exit, uint8_t priority, uint8_t minLevel, uint16_t costMs)
+{
+  #if SS_MAX_HOOKS > 0
+    if(hookCount >= SS_MAX_HOOKS)
+    {
+      return false;
+    }
+
+    // Insert after any of the same or lower priority
+    uint8_t x = hookCount;
+    while(x > 0 && hooks[x-1].priority > priority)
+    {
+      hooks[x] = hooks[x-1];
+      x--;
+    }
+
+    hooks[x].enter    = enter;
+    hooks[x].exit     = exit;
+    hooks[x].costMs   = costMs;
+    hooks[x].priority = priority;
+    hooks[x].minLevel = minLevel;
+    hookCount++;
+
+    return true;
+  #else
+    (void)(enter); (void)(exit); (void)(priority); (void)(minLevel); (void)(costMs); // Silence warning
+    return false;
+  #endif
+}
+
+void SimpleSleep::removeHook(SimpleSleep_HookFunction enter)
+{
+  #if SS_MAX_HOOKS > 0
+    uint8_t y = 0;
+    for(uint8_t x = 0; x < hookCount; x++)
+    {
+      if(hooks[x].enter != enter)
+      {
+        hooks[y++] = hooks[x];
+      }
+    }
+    hookCount = y;
+  #else
+    (void)(enter); // Silence warning
+  #endif
+}
+
+#if SS_MAX_HOOKS > 0
+
+  /** Run the enter hooks for a sleep of the given level and time (SS_UNTIMED if not timed),
+   *   returns a bit for each hook which was run, to be given to exitHooks().
+   */
+
+  uint8_t SimpleSleep::enterHooks(uint8_t level, uint32_t sleepMs)
+  {
+    uint8_t ran = 0;
+
+    for(uint8_t x = 0; x < hookCount; x++)
+    {
+      if(level < hooks[x].minLevel || hooks[x].costMs > sleepMs)
+      {
+        continue;
+      }
+
+      if(hooks[x].enter)
+      {
+        hooks[x].enter();
+      }
+      ran |= (1 << x);
+    }
+
+    return ran;
+  }
+
+  /** Run the exit hooks, in reverse order, for those which enterHooks() ran. */
+
+  void SimpleSleep::exitHooks(uint8_t ran)
+  {
+    for(uint8_t x = hookCount; x > 0; x--)
+    {
+      if((ran & (1 << (x-1))) && hooks[x-1].exit)
+      {
+        hooks[x-1].exit();
+      }
+    }
+  }
+
+#endif
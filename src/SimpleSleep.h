@@ -5,6 +5,45 @@
 
 #include "avr/avr.h"
 
+/** The number of hooks which can be registered with SimpleSleep::addHook(), 
+ *   each costs 8 bytes of RAM in the SimpleSleep object, at most 8.
+ * 
+ *  With any hooks every sleep also walks them on entry and exit, so there are 
+ *   none by default, define SS_MAX_HOOKS (here or in your build flags) to use them.
+ */
+
+#ifndef SS_MAX_HOOKS
+  #define SS_MAX_HOOKS 0
+#endif
+
+#if SS_MAX_HOOKS > 8
+  #error "SS_MAX_HOOKS can be at most 8"
+#endif
+
+/** Sleep levels, for SimpleSleep::addHook() */
+
+#define SS_LEVEL_IDLE    0
+#define SS_LEVEL_LIGHTLY 1
+#define SS_LEVEL_DEEPLY  2
+#define SS_LEVEL_FOREVER 3
+
+/** The sleepMs given to hooks for a sleep which is not timed */
+
+#define SS_UNTIMED 0xFFFFFFFFUL
+
+typedef void (*SimpleSleep_HookFunction)();
+
+/** A pair of functions registered with SimpleSleep::addHook() */
+
+struct SimpleSleep_Hook
+{
+  SimpleSleep_HookFunction enter;    // Called before sleeping, may be NULL
+  SimpleSleep_HookFunction exit;     // Called after waking, may be NULL
+  uint16_t                 costMs;   // Time it takes to power down and up again
+  uint8_t                  priority; // Lowest enters first and exits last
+  uint8_t                  minLevel; // SS_LEVEL_... at or above which to run
+};
+
 /** Simple Sleep class for Arduino.
  * 
  *     SimpleSleep Sleep;
@@ -35,14 +74,14 @@
       *
       */
       
-      inline void forever()                   { sleepForever(); }
+      inline void forever()                   { enterHooks(SS_LEVEL_FOREVER, SS_UNTIMED); sleepForever(); }
       
       /** Sleep deeply, allow external interrupts where possible (LEVEL only usually), bod off, adc off, timers generally off
        * 
        * For AVR, typically implemented as Power Down
        */
     
-      inline void deeply()                    { sleepDeeply();       }
+      inline void deeply()                    { uint8_t ran = enterHooks(SS_LEVEL_DEEPLY, SS_UNTIMED); sleepDeeply(); exitHooks(ran); }
             
       /** Sleep deeply for a given time, allow external interrupts where possible (LEVEL only usually), bod off, adc off, timers generally off
        * 
@@ -51,15 +90,53 @@
        * For AVR, typically implemented as Power Down
        */
       
-      inline void deeplyFor(uint32_t sleepMs) { sleepDeeply(sleepMs); }
+      inline void deeplyFor(uint32_t sleepMs) { uint8_t ran = enterHooks(SS_LEVEL_DEEPLY, sleepMs); sleepDeeply(sleepMs); exitHooks(ran); }
+      
+      
+      #ifdef SS_HAS_I2C_WAKE
+      
+      /** Sleep deeply, but stay addressable as an I2C (Wire) slave, an address match wakes you.
+       * 
+       *  Set up Wire as a slave first, `Wire.begin(address)`, the transaction is served
+       *  by Wire's interrupt as usual once awake, the master's clock is held (stretched)
+       *  while waking up.  If a transaction is in progress this returns without sleeping.
+       * 
+       *  For AVR, implemented as Power Down with only the TWI powered.  A transaction is
+       *  noticed by waiting (with interrupts off) SS_I2C_IDLE_US (100uS) for the TWI to
+       *  finish a byte, which covers masters clocking at 100kHz or faster.  Define it
+       *  longer for slower masters.
+       */
+      
+      inline void deeplyUntilI2C()             { uint8_t ran = enterHooks(SS_LEVEL_DEEPLY, SS_UNTIMED); sleepDeeplyUntilI2C(); exitHooks(ran); }
+      
+      #endif
+      
+      /** Sleep deeply for a given time in microseconds, finishing precisely on Timer1.
+       * 
+       *  Most of the time is slept deeply on the watchdog, the rest (15 to 30mS) in idle 
+       *  timed by Timer1 with a short spin at the end.  Only that last part is precise 
+       *  (to a few uS), its guard band adapts to how late waking up was, so the first 
+       *  few calls are the least precise.
+       * 
+       *  The deep part is not precise, nothing runs in Power Down to time it, so its error 
+       *  is never observed or corrected.  It is out by however far the watchdog has moved
+       *  from when it was last measured (each call re-measures it), plus the start-up
+       *  time from Power Down (fuse set) once, for a sleep of some seconds expect to be
+       *  out by milliseconds.  Sleep hooks are not run, they would throw off the timing.
+       * 
+       *  Timer1 is borrowed (and put back) but its interrupts are not used unless you 
+       *  define SS_PRECISE_ISR, see avr.h.  Where there is no 16 bit Timer1 (ATTinyX5,
+       *  ATTiny13) it is only as good as deeplyFor().
+       */
       
+      inline void preciselyFor(uint32_t sleepUs)  { sleepPrecisely(sleepUs); }
       
       /** Sleep lightly, allow many interrupts, adc off, timers generally off
        * 
        *  For AVR, typically either implemented as Extended Standby or ADC Noise Reduction with the ADC **OFF**.
        */
       
-      inline void lightly()                    { sleepLightly(); }
+      inline void lightly()                    { uint8_t ran = enterHooks(SS_LEVEL_LIGHTLY, SS_UNTIMED); sleepLightly(); exitHooks(ran); }
       
       /** Sleep lightly for a given time, allow many interrupts, adc off, timers generally off
        * 
@@ -68,7 +145,7 @@
        *  For AVR, typically either implemented as Extended Standby or ADC Noise Reduction with the ADC **OFF**.
        */
       
-      inline void lightlyFor(uint32_t sleepMs) { sleepLightly(sleepMs); }
+      inline void lightlyFor(uint32_t sleepMs) { uint8_t ran = enterHooks(SS_LEVEL_LIGHTLY, sleepMs); sleepLightly(sleepMs); exitHooks(ran); }
       
       /** Wait patiently, most anything can wake you including Serial, timers etc. 
        *
@@ -77,7 +154,7 @@
        *  For AVR, typically implemented as Idle
        */
       
-      inline void idle()                        { sleepIdle();       }
+      inline void idle()                        { uint8_t ran = enterHooks(SS_LEVEL_IDLE, SS_UNTIMED); sleepIdle(); exitHooks(ran); }
       
       /** Wait patiently for a given time.
        * 
@@ -88,20 +165,82 @@
        *  For AVR, typically implemented as Idle
        */
       
-      inline void idleFor(uint32_t sleepMs)     { sleepIdle(sleepMs); }
+      inline void idleFor(uint32_t sleepMs)     { uint8_t ran = enterHooks(SS_LEVEL_IDLE, sleepMs); sleepIdle(sleepMs); exitHooks(ran); }
+      
+      /** Wait patiently with only the given peripherals powered, everything else 
+       *  is powered down for the duration and restored exactly afterwards.
+       *
+       *     Sleep.idle(SS_KEEP_USART0 | SS_KEEP_TIMER0); // Serial and millis() only
+       * 
+       *  Which SS_KEEP_... are available depends on the chip, see the variant header.
+       *  The current saved by each peripheral powered down is tabled for each chip in
+       *  the README, from the datasheets' "Supply Current of IO Modules" (eg the ADC 
+       *  about 48uA on an ATMega328P at 3V 4MHz), not measured by this library.
+       * 
+       *  For AVR, implemented as Idle with the Power Reduction Register set
+       */
+      
+      inline void idle(SimpleSleep_Peripherals keep) { uint8_t ran = enterHooks(SS_LEVEL_IDLE, SS_UNTIMED); sleepIdle(keep); exitHooks(ran); }
+      
+      /** Wait patiently for a given time with only the given peripherals powered.
+       * 
+       *  Timer0 is always kept, it is needed for timing the sleep.
+       *
+       *  For AVR, implemented as Idle with the Power Reduction Register set
+       */
+      
+      inline void idleFor(uint32_t sleepMs, SimpleSleep_Peripherals keep) { uint8_t ran = enterHooks(SS_LEVEL_IDLE, sleepMs); sleepIdle(sleepMs, keep); exitHooks(ran); }
+      
+      /** Wait patiently with the system clock slowed down by 2^clockDivPower (eg 3 for /8).
+       * 
+       *  millis() continues to count correctly, the divider is reduced as necessary until
+       *  Timer0 can be sped up by the same amount to compensate (with the usual /64 Timer0, 
+       *  that means /8 or /64).  Other timers (PWM, tone etc) will run slower.
+       * 
+       *  With keepSerial the divider is also reduced until the hardware Serial baud rate
+       *  can be kept (within 2%) so Serial continues to receive, `Serial.flush()` first as
+       *  anything being sent at the time will be garbled.
+       * 
+       *  For AVR, implemented as Idle with the clock divided through CLKPR, chips without
+       *  CLKPR (ATMega8) just idle.
+       */
+      
+      inline void idleSlowly(uint8_t clockDivPower, bool keepSerial = false) { uint8_t ran = enterHooks(SS_LEVEL_IDLE, SS_UNTIMED); sleepIdleSlowly(clockDivPower, keepSerial); exitHooks(ran); }
+      
+      /** Wait patiently for a given time with the system clock slowed down by 2^clockDivPower.
+       * 
+       *  See idleSlowly() for the details.
+       */
+      
+      inline void idleSlowlyFor(uint32_t sleepMs, uint8_t clockDivPower, bool keepSerial = false) { uint8_t ran = enterHooks(SS_LEVEL_IDLE, sleepMs); sleepIdleSlowly(sleepMs, clockDivPower, keepSerial); exitHooks(ran); }
       
       /** For more accurate sleep times, you can generate calibration data and pass
        *  it into the deeplyFor, lightlyFor and idleFor.
        * 
        * Getting the calibration will take some time, more than 355 mS, during which
        * time the system is in idle() mode.
-       * 
+       *
+       * If millis() is not available (NO_MILLIS) the watchdog is instead timed
+       * with a busy-loop, in which case the system is awake, not idle, for that time.
+       *
        * You probably want to get fresh calibration data somewhat regularly, especially
        * if you experience temperature changes or voltage changes.
        */
       
       SimpleSleep_Cal getCalibration();
       
+      /** Get calibration data quickly, by timing a single watchdog period against Timer1
+       *  to the microsecond, rather than against millis().
+       * 
+       * This takes about 16 mS, during which time the system is awake, Timer1 is 
+       * borrowed and put back as it was afterwards (PWM on its pins will glitch).
+       * 
+       * Where there is no 16 bit Timer1 (ATTinyX5, ATTiny13) this is the same as 
+       * `getCalibration()`.
+       */
+      
+      SimpleSleep_Cal getFastCalibration();
+      
       /** Sleep deeply for a given time with a pre-determined calibration factor. 
        *
        * Use `getCalibration()` to obtain the calibration data.
@@ -123,6 +262,93 @@
       
       void idleFor(uint32_t sleepMs, SimpleSleep_Cal calibrationData);
       
+      /** Set the time of the software clock, in seconds since any epoch you like 
+       *  (eg a unix timestamp, in your local time if you will use untilNext()).
+       * 
+       *  The clock keeps counting through idle, timed sleeps and awake time, but not 
+       *  through untimed lightly() and deeply() sleeps (there is nothing to time them),
+       *  set or sync the time again after those.
+       * 
+       *  Where there is a 16 bit Timer1 (ATMega, ATTinyX4) the watchdog is measured 
+       *  against it here and in syncTime() (about 16mS) and sleeps are counted at the
+       *  measured length.
+       */
+      
+      void setTime(uint32_t epoch);
+      
+      /** Correct the software clock to the given (accurate) time, for example from GPS, 
+       *  NTP or a radio beacon, whenever you have one.
+       * 
+       *  The error since the last setTime() or syncTime() (if at least 10 minutes ago) is
+       *  used to correct the clock's drift from then on, so sync as often as you can.
+       */
+      
+      void syncTime(uint32_t epoch);
+      
+      /** Get the time from the software clock, see setTime() */
+      
+      uint32_t getTime();
+      
+      /** Sleep deeply until the software clock reaches the given time. 
+       *
+       *  The sleeps are lengthened or shortened by the drift correction (and where it 
+       *  has been measured, the WDT's actual period) so that the clock, rather than the 
+       *  nominal WDT time, reaches it, closing in with shorter sleeps towards the end.
+       */
+      
+      void untilTime(uint32_t epoch);
+      
+      /** Sleep deeply until the software clock next reaches the given time of day. 
+       *
+       *     Sleep.untilNext(6, 0); // Wake at 06:00
+       */
+      
+      void untilNext(uint8_t hours, uint8_t minutes);
+      
+      /** Register functions to be called before sleeping and after waking up, for
+       *  example to power down a radio and bring it back up again.
+       * 
+       *     Sleep.addHook(radioOff, radioOn, 10, SS_LEVEL_LIGHTLY, 5);
+       * 
+       *  Hooks run when sleeping at minLevel (SS_LEVEL_...) or deeper, enter hooks in 
+       *  order of lowest priority first and exit hooks in the reverse order.  For a timed
+       *  sleep shorter than costMs (the time it takes to power down and up again) the
+       *  hook is skipped.  Only the enter hooks run for forever().
+       * 
+       *  Returns false if there is no room (SS_MAX_HOOKS, 0 unless you define it) for
+       *  another hook.
+       */
+      
+      bool addHook(SimpleSleep_HookFunction enter, SimpleSleep_HookFunction exit, uint8_t priority, uint8_t minLevel, uint16_t costMs = 0);
+      
+      /** Remove all hooks registered with the given enter function. */
+      
+      void removeHook(SimpleSleep_HookFunction enter);
+      
+      #if SS_TRACE
+      
+      /** Copy the most recent sleep trace events (at most maxEvents) into events, oldest first.
+       *
+       *  Returns the number of events copied.  Only available when SS_TRACE is enabled.
+       */
+      
+      uint8_t getTrace(SimpleSleep_TraceEvent *events, uint8_t maxEvents);
+      
+      /** Print the sleep trace, oldest first, as CSV lines of
+       *  mode, wdtPeriod, wakeSource, awakeUs, requestedMs
+       *
+       *     Sleep.dumpTrace(Serial);
+       *
+       *  Only available when SS_TRACE is enabled.
+       */
+      
+      void dumpTrace(Print &out);
+      
+      /** Empty the sleep trace.  Only available when SS_TRACE is enabled. */
+      
+      void clearTrace();
+      
+      #endif
       
     protected:
     
@@ -136,6 +362,29 @@
       void sleepLightly(uint32_t sleepMs);
       void sleepIdle(uint32_t sleepMs);
       
+      void sleepIdle(SimpleSleep_Peripherals keep);
+      void sleepIdle(uint32_t sleepMs, SimpleSleep_Peripherals keep);
+      
+      #ifdef SS_HAS_I2C_WAKE
+        void sleepDeeplyUntilI2C();
+      #endif
+      
+      void sleepPrecisely(uint32_t sleepUs);
+      
+      void sleepIdleSlowly(uint8_t clockDivPower, uint8_t keepSerial);
+      void sleepIdleSlowly(uint32_t sleepMs, uint8_t clockDivPower, uint8_t keepSerial);
+      
+      #if SS_MAX_HOOKS > 0
+        SimpleSleep_Hook hooks[SS_MAX_HOOKS];
+        uint8_t          hookCount = 0;
+        
+        uint8_t enterHooks(uint8_t level, uint32_t sleepMs);
+        void    exitHooks(uint8_t ran);
+      #else
+        inline uint8_t enterHooks(uint8_t level, uint32_t sleepMs) { (void)(level); (void)(sleepMs); return 0; }
+        inline void    exitHooks(uint8_t ran)                      { (void)(ran); }
+      #endif
+      
   };
 
 #endif
\ No newline at end of file
@@ -2,6 +2,69 @@
 
 #if defined(SS_ATMegax8)
   
-  /* There is nothing to be done here, the standard methods defined in avr.cpp will work for us. */
+  /* The standard methods defined in avr.cpp work for us, only the TWI wake is particular to this variant. */
   
-#endif
\ No newline at end of file
+  #ifdef SS_HAS_I2C_WAKE
+  
+    #include <util/delay.h>
+    
+    void SimpleSleep::sleepDeeplyUntilI2C()
+    {
+      // ADC OFF
+      uint8_t oldADCSRA = ADCSRA;
+      ADCSRA &= ~(1 << ADEN);
+      
+      // Everything but the TWI off
+      power_declare_all();
+      power_save_all();
+      power_all_disable();
+      power_twi_enable();
+      
+      set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+      cli();
+      
+      // We must not Power Down part way through a transaction, but the status (TWSR) 
+      //  only says so while TWINT is set, between states it is 0xF8 the same as idle, 
+      //  and Wire's interrupt sees (and clears) those states, not us.
+      //
+      // With interrupts off though nothing clears TWINT, and during a transaction the 
+      //  TWI sets it at the end of every byte, so if it has not been set after a whole
+      //  byte's time there is no transaction going on.
+      uint8_t busy = 0;
+      for(uint16_t us = SS_I2C_IDLE_US; us && !busy; us--)
+      {
+        busy = TWCR & (1 << TWINT);
+        _delay_us(1);
+      }
+      
+      if(!busy)
+      {
+        // This only fills in the next event, it is not kept unless ss_trace_wake() 
+        //  is reached below, that is unless we really do sleep
+        ss_trace_sleep(SLEEP_MODE_PWR_DOWN, SS_TRACE_NO_WDT, 0);
+        sleep_enable();
+        
+        // One last look, as close to sleeping as the timed BOD disable allows
+        if(!(TWCR & (1 << TWINT)))
+        {
+          #ifdef sleep_bod_disable
+            sleep_bod_disable();
+          #endif
+          sei();
+          sleep_cpu();
+          ss_trace_wake(SS_TRACE_WAKE_OTHER);
+        }
+        
+        sleep_disable();
+      }
+      
+      // Wire's interrupt now serves whatever woke us (or was in progress)
+      sei();
+      
+      power_restore_all();
+      ADCSRA = oldADCSRA;
+    }
+  
+  #endif
+  
+#endif
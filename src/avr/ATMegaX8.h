@@ -13,6 +13,70 @@
 
     #define SS_SUPPORTED_CHIP
     #define SS_ATMegax8
+    
+    /** Peripherals which can be kept powered while idle, these are the 
+     *   Power Reduction Register bits, anything not kept is powered down.
+     * 
+     *  The ATMega8 has no PRR so there is nothing to power down.
+     */
+    
+    // The TWI address match can wake us from Power Down, see SimpleSleep::deeplyUntilI2C()
+    #if defined(TWCR) && defined(PRR)
+      #define SS_HAS_I2C_WAKE
+      
+      // How long (uS) the TWI must be quiet before deeplyUntilI2C() will sleep, at least 
+      //  one byte (9 clocks) at the slowest I2C clock used, 90uS is 100kHz.
+      #ifndef SS_I2C_IDLE_US
+        #define SS_I2C_IDLE_US 100
+      #endif
+    #endif
+    
+    #if defined(PRR)
+      enum SimpleSleep_Peripherals : uint8_t
+      {
+        SS_KEEP_NONE   = 0,
+        SS_KEEP_ADC    = _BV(PRADC),
+        SS_KEEP_USART0 = _BV(PRUSART0),
+        SS_KEEP_SPI    = _BV(PRSPI),
+        SS_KEEP_TIMER1 = _BV(PRTIM1),
+        SS_KEEP_TIMER0 = _BV(PRTIM0),
+        SS_KEEP_TIMER2 = _BV(PRTIM2),
+        SS_KEEP_TWI    = _BV(PRTWI),
+        SS_KEEP_ALL    = SS_KEEP_ADC | SS_KEEP_USART0 | SS_KEEP_SPI | SS_KEEP_TIMER1 | SS_KEEP_TIMER0 | SS_KEEP_TIMER2 | SS_KEEP_TWI
+      };
+    #elif defined(PRR0)
+      /** The ATMega328PB has PRR0 and PRR1 instead, its first SPI and TWI are numbered 
+       *   (PRSPI0, PRTWI0) and USART1 is in PRR0 too.  Only PRR0 is used here, the 
+       *   second SPI and TWI and Timers 3 and 4 (PRR1) are left as they are.
+       */
+      
+      enum SimpleSleep_Peripherals : uint8_t
+      {
+        SS_KEEP_NONE   = 0,
+        SS_KEEP_ADC    = _BV(PRADC),
+        SS_KEEP_USART0 = _BV(PRUSART0),
+        SS_KEEP_USART1 = _BV(PRUSART1),
+        SS_KEEP_SPI    = _BV(PRSPI0),
+        SS_KEEP_TIMER1 = _BV(PRTIM1),
+        SS_KEEP_TIMER0 = _BV(PRTIM0),
+        SS_KEEP_TIMER2 = _BV(PRTIM2),
+        SS_KEEP_TWI    = _BV(PRTWI0),
+        SS_KEEP_ALL    = SS_KEEP_ADC | SS_KEEP_USART0 | SS_KEEP_USART1 | SS_KEEP_SPI | SS_KEEP_TIMER1 | SS_KEEP_TIMER0 | SS_KEEP_TIMER2 | SS_KEEP_TWI
+      };
+    #else
+      enum SimpleSleep_Peripherals : uint8_t
+      {
+        SS_KEEP_NONE   = 0,
+        SS_KEEP_ADC    = 0,
+        SS_KEEP_USART0 = 0,
+        SS_KEEP_SPI    = 0,
+        SS_KEEP_TIMER1 = 0,
+        SS_KEEP_TIMER0 = 0,
+        SS_KEEP_TIMER2 = 0,
+        SS_KEEP_TWI    = 0,
+        SS_KEEP_ALL    = 0
+      };
+    #endif
 
   #endif
   
@@ -10,6 +10,30 @@
     #define WDTCSR WDTCR
     #define WDIE   WDTIE
     
+    /** Peripherals which can be kept powered while idle, these are the 
+     *   Power Reduction Register bits, anything not kept is powered down.
+     * 
+     *  Only the Tiny13A has a PRR, on the Tiny13 there is nothing to power down.
+     */
+    
+    #ifdef PRR
+      enum SimpleSleep_Peripherals : uint8_t
+      {
+        SS_KEEP_NONE   = 0,
+        SS_KEEP_ADC    = _BV(PRADC),
+        SS_KEEP_TIMER0 = _BV(PRTIM0),
+        SS_KEEP_ALL    = SS_KEEP_ADC | SS_KEEP_TIMER0
+      };
+    #else
+      enum SimpleSleep_Peripherals : uint8_t
+      {
+        SS_KEEP_NONE   = 0,
+        SS_KEEP_ADC    = 0,
+        SS_KEEP_TIMER0 = 0,
+        SS_KEEP_ALL    = 0
+      };
+    #endif
+    
     // While we do have a WDT interrupt, it uses quite a lot of 
     #define WDT_HAS_INTERRUPT 1
     #if ! defined( WDT_HAS_INTERRUPT ) && ! defined( NO_MILLIS )
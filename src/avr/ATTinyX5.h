@@ -8,6 +8,20 @@
   
     // T85 uses WDTCR instead of WDTCSR
     #define WDTCSR WDTCR
+
+    /** Peripherals which can be kept powered while idle, these are the 
+     *   Power Reduction Register bits, anything not kept is powered down.
+     */
+    
+    enum SimpleSleep_Peripherals : uint8_t
+    {
+      SS_KEEP_NONE   = 0,
+      SS_KEEP_ADC    = _BV(PRADC),
+      SS_KEEP_USI    = _BV(PRUSI),
+      SS_KEEP_TIMER0 = _BV(PRTIM0),
+      SS_KEEP_TIMER1 = _BV(PRTIM1),
+      SS_KEEP_ALL    = SS_KEEP_ADC | SS_KEEP_USI | SS_KEEP_TIMER0 | SS_KEEP_TIMER1
+    };
     
   #endif    
 #endif
\ No newline at end of file
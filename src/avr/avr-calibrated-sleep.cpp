@@ -1,66 +1,170 @@
 /** This file contains implementation of calibration which are common amongst AVR chips.
- *  
+ *
  *  Keep ifdef to a minimum, use variant implementation files if there is any substantial difference.
  */
 
 #if defined (__AVR__)
-  
+
   #include "../SimpleSleep.h"
-  
+
   #ifdef NO_MILLIS
     // Some of the Arduino cores, particularly @sleemanj's ATTinyCore fork,
-    //  allow disabling millis, in which case we can not do any 
-    //
-    // @TODO Maybe there is some way to do it using a delay() (which will
-    //   still work without millis()), like, start the WDT then start a delay()
-    //   if the WDT triggers before the delay() time then the WDT needed to be longer
-    //   if it hasn't finished when the delay has it needed to be shorter...
+    //  allow disabling millis, in which case we can not time the WDT
+    //  against millis().
     //
-    SimpleSleep_Cal SimpleSleep::getCalibration()
-    {
-      return 1;
-    }
-      
-    void SimpleSleep::deeplyFor(uint32_t sleepMs, SimpleSleep_Cal calData)
-    {
-      (void)(calData); // Silence unused warning
-      deeplyFor(sleepMs);
-    }
+    // Instead we start the WDT and then spin in 1mS busy-loops (which do
+    //  not need any timer) until the WDT triggers, the number of loops
+    //  completed is how long the WDT period actually was.
 
-    void SimpleSleep::lightlyFor(uint32_t sleepMs, SimpleSleep_Cal calData)
-    {
-      (void)(calData); // Silence unused warning
-      lightlyFor(sleepMs);
-    }
+    #if WDT_HAS_INTERRUPT == 1
+      #include <util/delay_basic.h>
 
-    void SimpleSleep::idleFor(uint32_t sleepMs, SimpleSleep_Cal calData)
+      // _delay_loop_2() takes 4 cycles per count, the outer loop costs about
+      //  another 8 cycles (2 counts) each time around
+      #define SS_CAL_SPIN_COUNT ((F_CPU / 4000UL) - 2)
+
+      /** Start the WDT for the given period (WDTO_...) and count how many
+       *   milliseconds pass until it triggers.
+       *
+       *  Other interrupts firing during the count will lengthen the loops,
+       *   but without millis there is usually nothing else running.
+       */
+
+      static uint16_t wdt_spin_count(uint8_t wdtPeriod)
+      {
+        cli();
+        wdt_triggered = 0;
+        wdt_enable(wdtPeriod);
+        WDTCSR |= (1 << WDIE);
+        sei();
+
+        // Half a loop first so the count is rounded rather than rounded up
+        uint16_t ms = 0;
+        _delay_loop_2(SS_CAL_SPIN_COUNT / 2);
+        while(!wdt_triggered)
+        {
+          _delay_loop_2(SS_CAL_SPIN_COUNT);
+          ms++;
+        }
+
+        return ms;
+      }
+    #endif
+  #endif
+
+  #ifdef SS_HAS_WDT_MEASURE
+
+    uint32_t wdt_measure_us(uint8_t periods)
     {
-      (void)(calData); // Silence unused warning
-      idleFor(sleepMs);
+      uint8_t  oldTCCR1A = TCCR1A;
+      uint8_t  oldTCCR1B = TCCR1B;
+      uint8_t  oldTIMSK1 = TIMSK1;
+      uint16_t oldTCNT1  = TCNT1;
+      #ifdef SS_PRR
+        uint8_t oldPRR = SS_PRR;
+        power_timer1_enable();
+      #endif
+
+      // Normal mode, no interrupts, stopped
+      TIMSK1 = 0;
+      TCCR1A = 0;
+      TCCR1B = 0;
+
+      uint32_t ticks = 0;
+      while(periods--)
+      {
+        cli();
+        wdt_triggered = 0;
+        TCNT1 = 0;
+        TIFR1 = (1 << TOV1);
+        wdt_enable(WDTO_15MS);
+        TCCR1B = (1 << CS11); // F_CPU/8
+        WDTCSR |= (1 << WDIE);
+        sei();
+
+        // Count the overflows until the WDT triggers
+        uint16_t overflows = 0;
+        while(!wdt_triggered)
+        {
+          if(TIFR1 & (1 << TOV1))
+          {
+            TIFR1 = (1 << TOV1);
+            overflows++;
+          }
+        }
+
+        uint16_t t = TCNT1;
+        TCCR1B = 0;
+
+        // An overflow may have happened after the last check
+        if((TIFR1 & (1 << TOV1)) && t < 0x8000)
+        {
+          overflows++;
+        }
+
+        ticks += ((uint32_t)overflows << 16) + t;
+      }
+
+      TIFR1  = (1 << TOV1) | (1 << OCF1A) | (1 << OCF1B) | (1 << ICF1);
+      TCNT1  = oldTCNT1;
+      TCCR1A = oldTCCR1A;
+      TCCR1B = oldTCCR1B;
+      TIMSK1 = oldTIMSK1;
+      #ifdef SS_PRR
+        SS_PRR = oldPRR;
+      #endif
+
+      // 8 clocks per tick
+      return (ticks * 8000UL) / (F_CPU / 1000UL);
     }
 
-  #elif SS_USE_INT_CAL == 1
+  #endif
+
+  #if SS_USE_INT_CAL == 1
 
     __attribute__((weak)) SimpleSleep_Cal SimpleSleep::getCalibration()
     {
       SimpleSleep_Cal calData;
-      
-      uint32_t m = millis();
-      idleFor(15);
-      m = millis() - m;
-      calData.adjust15MS = 15 - m;
-      
-      m = millis();
-      idleFor(250);
-      m=millis() - m;
-      calData.adjust250MS = 250 - m;
-      
+
+      #ifdef NO_MILLIS
+        #if WDT_HAS_INTERRUPT == 1
+          calData.adjust15MS  = 15  - wdt_spin_count(WDTO_15MS);
+          calData.adjust250MS = 250 - wdt_spin_count(WDTO_250MS);
+        #endif
+      #else
+        uint32_t m = millis();
+        sleepIdle(15);
+        m = millis() - m;
+        calData.adjust15MS = 15 - m;
+
+        m = millis();
+        sleepIdle(250);
+        m=millis() - m;
+        calData.adjust250MS = 250 - m;
+      #endif
+
       return calData;
     }
 
+    __attribute__((weak)) SimpleSleep_Cal SimpleSleep::getFastCalibration()
+    {
+      #ifdef SS_HAS_WDT_MEASURE
+        SimpleSleep_Cal calData;
+        
+        // The 250mS period is 16 times the 15mS one (32K vs 2K WDT oscillator cycles)
+        uint32_t us = wdt_measure_us(1);
+        calData.adjust15MS  = 15  - (int16_t)((us + 500) / 1000);
+        calData.adjust250MS = 250 - (int16_t)((us * 16 + 500) / 1000);
+        
+        return calData;
+      #else
+        return getCalibration();
+      #endif
+    }
+
     __attribute__((weak)) void SimpleSleep::deeplyFor(uint32_t sleepMs, SimpleSleep_Cal calData)
     {
-      sleepDeeply(sleepMs + ((sleepMs/250)*calData.adjust250MS) + (((sleepMs - ((sleepMs/250)*250))/15)*calData.adjust15MS));
+      deeplyFor(sleepMs + ((sleepMs/250)*calData.adjust250MS) + (((sleepMs - ((sleepMs/250)*250))/15)*calData.adjust15MS));
     }
 
     __attribute__((weak)) void SimpleSleep::lightlyFor(uint32_t sleepMs, SimpleSleep_Cal calData)
@@ -77,10 +181,27 @@
 
     __attribute__((weak)) SimpleSleep_Cal SimpleSleep::getCalibration()
     {
-      uint32_t m = millis();
-      idleFor(15);
-      m = millis() - m;
-      return (float)15 / (float)m;
+      #ifdef NO_MILLIS
+        #if WDT_HAS_INTERRUPT == 1
+          return (float)15 / (float)wdt_spin_count(WDTO_15MS);
+        #else
+          return 1;
+        #endif
+      #else
+        uint32_t m = millis();
+        sleepIdle(15);
+        m = millis() - m;
+        return (float)15 / (float)m;
+      #endif
+    }
+
+    __attribute__((weak)) SimpleSleep_Cal SimpleSleep::getFastCalibration()
+    {
+      #ifdef SS_HAS_WDT_MEASURE
+        return (float)15000 / (float)wdt_measure_us(1);
+      #else
+        return getCalibration();
+      #endif
     }
 
     __attribute__((weak)) void SimpleSleep::deeplyFor(uint32_t sleepMs, SimpleSleep_Cal calData)
@@ -98,4 +219,4 @@
       idleFor(sleepMs * calData);
     }
   #endif
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,313 @@
+/** This file contains implementation of precise sleeping which is common amongst AVR chips with a 16 bit Timer1.
+ *
+ *  A precise sleep is made of two phases,
+ *
+ *   1. deep, whole WDT periods in Power Down, their lengths predicted from a measured
+ *      (to the microsecond) WDT period, ending between one and two 15mS periods before
+ *      the deadline.
+ *
+ *   2. fine, Idle with Timer1 counting down the rest, until a guard band before the
+ *      deadline, and then we spin on Timer1 for the last few ticks.
+ *
+ *      No interrupt is used for Timer1 (so that Servo, TimerOne or your own Timer1 
+ *      interrupts still link), instead we idle between the Timer0 overflows (millis())
+ *      checking Timer1 each time we wake, and spin once the next overflow would be too
+ *      late.  With SS_PRECISE_ISR the Timer1 compare interrupt wakes us instead, so
+ *      less time is spent spinning.
+ *
+ *  The fine phase adapts from what it observes.  A 15mS WDT period is timed against 
+ *  Timer1, which keeps the WDT prediction for the next deep phase up to date.  How late 
+ *  we actually got out of Idle sets the guard band for next time, as small as it can be 
+ *  without overshooting.
+ *
+ *  The deep phase does not.  Nothing can time it (no clock runs in Power Down), so its 
+ *  error is never observed let alone corrected, it is only as good as the WDT prediction.
+ *  The WDT is left running from one period into the next so that the chip's start-up 
+ *  time from Power Down (set by fuses) is added once, not for each period.  Only the 
+ *  fine phase is precise.
+ *
+ *  Keep ifdef to a minimum, use variant implementation files if there is any substantial difference.
+ */
+
+#if defined (__AVR__)
+
+  #include "../SimpleSleep.h"
+
+  #ifdef SS_HAS_WDT_MEASURE
+
+    // Timer1 runs at F_CPU/64 for the fine phase (4uS ticks at 16MHz)
+    #define SS_PRECISE_TICKS(us)  ((uint16_t)(((uint32_t)(us) * (F_CPU / 1000UL)) / 64000UL))
+    #define SS_PRECISE_US(ticks)  ((uint32_t)(((uint32_t)(ticks) * 64000UL) / (F_CPU / 1000UL)))
+
+    static uint32_t precise_t15   = 0;  // Predicted length of a 15mS WDT period, uS, 0 if not yet measured
+    static uint16_t precise_guard = 4;  // Guard band in Timer1 ticks before the deadline to stop idling
+
+    #if SS_PRECISE_ISR
+      static volatile uint8_t precise_compared = 0;
+
+      ISR (TIMER1_COMPA_vect)
+      {
+        TIMSK1 &= ~(1 << OCIE1A);
+        precise_compared = 1;
+      }
+    #else
+      // Timer0 prescaler for each CS0x clock select
+      static const uint16_t precise_t0_prescale[] = { 0, 1, 8, 64, 256, 1024 };
+    #endif
+
+    /** Run the WDT in interrupt only mode with the given period, without resetting it.
+     * 
+     *  wdt_enable() resets the WDT, so each period would start only once we are up
+     *   again from Power Down and the start-up time (fuse set, 16K clocks on an Uno)
+     *   would be added to every one.  Run on like this, each period follows on from 
+     *   the timeout of the last.  Call with interrupts disabled.  (If WDRF in MCUSR
+     *   is set WDE stays set, the interrupt then stops the WDT as after wdt_enable().)
+     * 
+     *  The second write must be within 4 cycles of the first, so as in avr/wdt.h it
+     *   is done in assembly.
+     */
+
+    static inline void precise_wdt_run(uint8_t wdtPeriod)
+    {
+      #ifdef WDP3
+        uint8_t wdtcsr = (1 << WDIE) | (wdtPeriod & 0x07) | (wdtPeriod & 0x08 ? (1 << WDP3) : 0);
+      #else
+        uint8_t wdtcsr = (1 << WDIE) | (wdtPeriod & 0x07);
+      #endif
+
+      __asm__ __volatile__ (
+        "sts %[reg], %[change]" "\n\t"
+        "sts %[reg], %[wdtcsr]" "\n\t"
+        :
+        : [reg]    "n" (_SFR_MEM_ADDR(WDTCSR)),
+          [change] "r" ((uint8_t)((1 << WDCE) | (1 << WDE))),
+          [wdtcsr] "r" (wdtcsr)
+      );
+    }
+
+    /** Sleep one WDT period in Power Down, going back to sleep after any other interrupt */
+
+    static void precise_wdt_sleep(uint8_t wdtPeriod)
+    {
+      cli();
+      wdt_triggered = 0;
+      precise_wdt_run(wdtPeriod);
+      sei();
+
+      wdt_slept_ms    += wdt_period_ms(wdtPeriod);
+      wdt_slept_units += (uint16_t)1 << wdtPeriod;
+
+      set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+      for(;;)
+      {
+        cli();
+        if(wdt_triggered)
+        {
+          sei();
+          break;
+        }
+
+        ss_trace_sleep(SLEEP_MODE_PWR_DOWN, wdtPeriod, 0);
+        sleep_enable();
+        #ifdef sleep_bod_disable
+          sleep_bod_disable();
+        #endif
+        sei();
+        sleep_cpu();
+        sleep_disable();
+        ss_trace_wake(wdt_triggered ? SS_TRACE_WAKE_WDT : SS_TRACE_WAKE_OTHER);
+        sei();
+      }
+    }
+
+    __attribute__((weak)) void SimpleSleep::sleepPrecisely(uint32_t sleepUs)
+    {
+      // We need to know the WDT period to start with, the time spent doing so counts
+      if(!precise_t15)
+      {
+        precise_t15 = wdt_measure_us(1);
+        sleepUs     = sleepUs > precise_t15 ? sleepUs - precise_t15 : 0;
+      }
+
+      // Deep phase, leave at least one 15mS period (to measure) and the guard band
+      uint32_t keepUs = precise_t15 + SS_PRECISE_US(precise_guard);
+      if(sleepUs > keepUs)
+      {
+        uint32_t deepUs = sleepUs - keepUs;
+
+        uint8_t oldADCSRA = ADCSRA;
+        ADCSRA &= ~(1 << ADEN);
+
+        power_declare_all();
+        power_save_all();
+        power_all_disable();
+
+        // The WDT periods are each double the last (2K to 1024K oscillator cycles)
+        #ifdef WDP3
+          int8_t x = 9;
+        #else
+          int8_t x = 7;
+        #endif
+        wdt_reset();
+        for(; x >= 0; x--)
+        {
+          while(deepUs >= (precise_t15 << x))
+          {
+            precise_wdt_sleep(x);
+            deepUs  -= precise_t15 << x;
+            sleepUs -= precise_t15 << x;
+          }
+        }
+
+        cli();
+        wdt_disable();
+        wdt_triggered = 1;
+        sei();
+
+        power_restore_all();
+        ADCSRA = oldADCSRA;
+      }
+
+      // Fine phase, Timer1 counts the rest while we idle
+      uint8_t  oldTCCR1A = TCCR1A;
+      uint8_t  oldTCCR1B = TCCR1B;
+      uint8_t  oldTIMSK1 = TIMSK1;
+      uint16_t oldOCR1A  = OCR1A;
+      uint16_t oldTCNT1  = TCNT1;
+      #ifdef SS_PRR
+        uint8_t oldPRR = SS_PRR;
+        power_timer1_enable();
+      #endif
+
+      uint16_t target  = SS_PRECISE_TICKS(sleepUs);
+      uint8_t  measure = sleepUs > precise_t15;
+
+      #if SS_PRECISE_ISR
+        // The compare wakes us, at once
+        uint16_t slack = 0;
+      #else
+        // A Timer0 overflow wakes us, up to one Timer0 period (in Timer1 ticks) later, 
+        //  without those (NO_MILLIS) there is nothing to wake us so we just spin
+        uint8_t  cs    = TCCR0B & 0x07;
+        uint16_t slack = (TIMSK0 & (1 << TOIE0)) && cs >= 1 && cs <= 5 ? precise_t0_prescale[cs] * 4 : 0xFFFF;
+      #endif
+
+      uint16_t wake = target > precise_guard + (uint32_t)slack ? target - precise_guard - slack : 0;
+
+      TIMSK1 = 0;
+      TCCR1A = 0;
+      TCCR1B = 0;
+      TCNT1  = 0;
+      OCR1A  = wake;
+      TIFR1  = (1 << TOV1) | (1 << OCF1A) | (1 << OCF1B) | (1 << ICF1);
+      #if SS_PRECISE_ISR
+        precise_compared = 0;
+      #endif
+
+      cli();
+      if(measure)
+      {
+        wdt_triggered = 0;
+        wdt_enable(WDTO_15MS);
+        WDTCSR |= (1 << WDIE);
+      }
+      TCCR1B = (1 << CS11) | (1 << CS10); // F_CPU/64
+      #if SS_PRECISE_ISR
+        if(wake)
+        {
+          TIMSK1 = (1 << OCIE1A);
+        }
+      #endif
+      sei();
+
+      uint16_t wdtAt = 0;
+      set_sleep_mode(SLEEP_MODE_IDLE);
+      while(wake)
+      {
+        cli();
+        #if SS_PRECISE_ISR
+          if(precise_compared)
+        #else
+          if(TIFR1 & (1 << OCF1A))
+        #endif
+        {
+          sei();
+          break;
+        }
+
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+
+        if(measure && !wdtAt && wdt_triggered)
+        {
+          wdtAt = TCNT1;
+        }
+      }
+
+      // Spin the last few ticks, noting how late we got here (beyond the slack allowed for)
+      uint16_t late = wake ? TCNT1 - wake : 0;
+      late = late > slack ? late - slack : 0;
+      while(TCNT1 < target)
+      {
+        if(measure && !wdtAt && wdt_triggered)
+        {
+          wdtAt = TCNT1;
+        }
+      }
+
+      TCCR1B = 0;
+      TIMSK1 = 0;
+
+      // Adapt the guard band, straight up if we were too late, slowly down towards
+      //  twice the lateness if we were in time
+      if(late + 1 >= precise_guard)
+      {
+        precise_guard = late * 2 + 1;
+      }
+      else
+      {
+        precise_guard = (precise_guard * 3 + late * 2 + 3) / 4;
+      }
+
+      // Adapt the WDT prediction by a quarter of the observed error
+      if(wdtAt)
+      {
+        int32_t error = (int32_t)SS_PRECISE_US(wdtAt) - (int32_t)precise_t15;
+        precise_t15 += error / 4;
+      }
+      else if(measure)
+      {
+        cli();
+        wdt_disable();
+        wdt_triggered = 1;
+        sei();
+      }
+
+      TIFR1  = (1 << TOV1) | (1 << OCF1A) | (1 << OCF1B) | (1 << ICF1);
+      TCNT1  = oldTCNT1;
+      OCR1A  = oldOCR1A;
+      TCCR1A = oldTCCR1A;
+      TCCR1B = oldTCCR1B;
+      TIMSK1 = oldTIMSK1;
+      #ifdef SS_PRR
+        SS_PRR = oldPRR;
+      #endif
+    }
+
+  #else
+
+    // Without a 16 bit Timer1 there is nothing to be precise with, get as close as we can
+
+    __attribute__((weak)) void SimpleSleep::sleepPrecisely(uint32_t sleepUs)
+    {
+      if(sleepUs >= 1000)
+      {
+        sleepDeeply(sleepUs / 1000);
+      }
+      delayMicroseconds(sleepUs % 1000);
+    }
+
+  #endif
+#endif
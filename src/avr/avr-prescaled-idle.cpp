@@ -0,0 +1,173 @@
+/** This file contains implementation of idling with a reduced system clock, which is common amongst AVR chips.
+ *
+ *  The system clock is divided through CLKPR for the duration of the idle, Timer0's prescaler
+ *  is reduced by the same amount so that millis() keeps counting correctly, and optionally the
+ *  USART baud rate divisor is reduced too so that Serial continues to receive at the same rate.
+ *
+ *  Keep ifdef to a minimum, use variant implementation files if there is any substantial difference.
+ */
+
+#if defined (__AVR__)
+
+  #include "../SimpleSleep.h"
+
+  #ifdef CLKPR
+
+    // Timer0 prescaler as a power of two for each CS0x clock select, 1 (/1) to 5 (/1024)
+    static const uint8_t timer0_shift[] = { 0, 0, 3, 6, 8, 10 };
+
+    /** Reduce the system clock by up to 2^clockDivPower, returns the power of two actually
+     *   used, which is reduced until Timer0 (and with keepSerial, the USART) can be
+     *   compensated, 0 if the clock can not be slowed at all.
+     */
+
+    static uint8_t clock_slow(uint8_t clockDivPower, uint8_t keepSerial)
+    {
+      uint8_t oldClock = CLKPR & 0x0F;
+      uint8_t cs       = TCCR0B & 0x07;
+      uint8_t newCs    = cs;
+      #ifdef UBRR0
+        uint16_t newUBRR = UBRR0;
+      #endif
+
+      // 256 (2^8) is the maximum system clock division
+      if(clockDivPower > 8 - oldClock)
+      {
+        clockDivPower = 8 - oldClock;
+      }
+
+      for(; clockDivPower; clockDivPower--)
+      {
+        // Timer0 must be able to run that much faster, unless it is stopped (0)
+        //  or on an external clock (6, 7) in which case the system clock does not matter
+        if(cs >= 1 && cs <= 5)
+        {
+          for(newCs = cs - 1; newCs >= 1; newCs--)
+          {
+            if(timer0_shift[newCs] + clockDivPower == timer0_shift[cs]) break;
+          }
+
+          if(newCs < 1) continue;
+        }
+
+        #ifdef UBRR0
+          // The baud rate divisor must be reducible by the same amount within 2%
+          if(keepSerial)
+          {
+            uint16_t n      = UBRR0 + 1;
+            uint16_t q      = (n + (1 << (clockDivPower - 1))) >> clockDivPower;
+            uint32_t approx = (uint32_t)q << clockDivPower;
+            uint32_t err    = approx > n ? approx - n : n - approx;
+            
+            if(!q || err * 50 > n) continue;
+            newUBRR = q - 1;
+          }
+        #else
+          (void)(keepSerial); // Silence warning
+        #endif
+
+        break;
+      }
+
+      if(!clockDivPower) return 0;
+
+      uint8_t oldSREG = SREG;
+      cli();
+
+      TCCR0B = (TCCR0B & ~0x07) | newCs;
+
+      #ifdef UBRR0
+        if(keepSerial)
+        {
+          UBRR0 = newUBRR;
+        }
+      #endif
+
+      // The CLKPCE sequence is timed (4 cycles), avr/power.h does it in assembly
+      clock_prescale_set((clock_div_t)(oldClock + clockDivPower));
+
+      SREG = oldSREG;
+
+      return clockDivPower;
+    }
+
+    /** Put back the system clock, Timer0 and USART as they were before clock_slow() */
+
+    static void clock_restore(uint8_t oldCLKPR, uint8_t oldTCCR0B, uint16_t oldUBRR)
+    {
+      uint8_t oldSREG = SREG;
+      cli();
+
+      clock_prescale_set((clock_div_t)oldCLKPR);
+
+      TCCR0B = oldTCCR0B;
+
+      #ifdef UBRR0
+        UBRR0 = oldUBRR;
+      #else
+        (void)(oldUBRR); // Silence warning
+      #endif
+
+      SREG = oldSREG;
+    }
+
+    __attribute__((weak)) void SimpleSleep::sleepIdleSlowly(uint8_t clockDivPower, uint8_t keepSerial)
+    {
+      uint8_t  oldCLKPR  = CLKPR & 0x0F;
+      uint8_t  oldTCCR0B = TCCR0B;
+      #ifdef UBRR0
+        uint16_t oldUBRR = UBRR0;
+      #else
+        uint16_t oldUBRR = 0;
+      #endif
+
+      if(clock_slow(clockDivPower, keepSerial))
+      {
+        sleepIdle();
+        clock_restore(oldCLKPR, oldTCCR0B, oldUBRR);
+      }
+      else
+      {
+        sleepIdle();
+      }
+    }
+
+    __attribute__((weak)) void SimpleSleep::sleepIdleSlowly(uint32_t sleepMs, uint8_t clockDivPower, uint8_t keepSerial)
+    {
+      uint8_t  oldCLKPR  = CLKPR & 0x0F;
+      uint8_t  oldTCCR0B = TCCR0B;
+      #ifdef UBRR0
+        uint16_t oldUBRR = UBRR0;
+      #else
+        uint16_t oldUBRR = 0;
+      #endif
+
+      if(clock_slow(clockDivPower, keepSerial))
+      {
+        sleepIdle(sleepMs);
+        clock_restore(oldCLKPR, oldTCCR0B, oldUBRR);
+      }
+      else
+      {
+        sleepIdle(sleepMs);
+      }
+    }
+
+  #else
+
+    // Without a clock prescaler register (eg ATMega8) this is just idle
+
+    __attribute__((weak)) void SimpleSleep::sleepIdleSlowly(uint8_t clockDivPower, uint8_t keepSerial)
+    {
+      (void)(clockDivPower); (void)(keepSerial); // Silence warning
+      sleepIdle();
+    }
+
+    __attribute__((weak)) void SimpleSleep::sleepIdleSlowly(uint32_t sleepMs, uint8_t clockDivPower, uint8_t keepSerial)
+    {
+      (void)(clockDivPower); (void)(keepSerial); // Silence warning
+      sleepIdle(sleepMs);
+    }
+
+  #endif
+#endif
@@ -0,0 +1,172 @@
+/** This file contains implementation of the software clock which is common amongst AVR chips.
+ *
+ *  The clock is kept as seconds (and milliseconds) since some epoch of your choosing, it
+ *  is advanced by millis() while awake or idle, plus the WDT periods slept through while
+ *  millis() was stopped, corrected by the drift measured between syncTime()s.
+ *
+ *  Where there is a 16 bit Timer1 the WDT is measured against it at each setTime() and
+ *  syncTime() and the periods slept (wdt_slept_units) are counted at that length, else
+ *  they are counted at their nominal length (wdt_slept_ms) and the drift correction
+ *  has to make up for the WDT's error as well.
+ *
+ *  Keep ifdef to a minimum, use variant implementation files if there is any substantial difference.
+ */
+
+#if defined (__AVR__)
+
+  #include "../SimpleSleep.h"
+
+  static uint32_t rtc_seconds = 0;  // The time
+  static uint16_t rtc_ms      = 0;  //  and the mS part of it
+  static uint32_t rtc_millis  = 0;  // millis() when the time was last updated
+  static uint32_t rtc_slept   = 0;  // wdt_slept_ms when the time was last updated
+  static int16_t  rtc_drift   = 0;  // Correction for drift in 1/65536ths of the elapsed time
+  static uint16_t rtc_frac    = 0;  // The part of a mS of correction carried over to the next update
+  static uint32_t rtc_synced  = 0;  // The time at the last setTime()/syncTime(), 0 if never
+
+  #ifdef SS_HAS_WDT_MEASURE
+    static uint32_t rtc_units   = 0;  // wdt_slept_units when the time was last updated
+    static uint32_t rtc_t15     = 0;  // Measured length in uS of one unit (15mS period), 0 if not yet
+    static uint16_t rtc_us      = 0;  // The part of a mS of WDT sleep carried over to the next update
+  #endif
+
+  /** Bring the time up to date, this must happen more often than millis() wraps (49 days),
+   *   getTime() and untilTime() do so.
+   */
+
+  static void rtc_update()
+  {
+    uint32_t elapsed = wdt_slept_ms - rtc_slept;
+    rtc_slept = wdt_slept_ms;
+
+    #ifdef SS_HAS_WDT_MEASURE
+      // Count the WDT periods at their measured length instead of their nominal one
+      if(rtc_t15)
+      {
+        uint64_t us = (uint64_t)(wdt_slept_units - rtc_units) * rtc_t15 + rtc_us;
+        elapsed = us / 1000;
+        rtc_us  = us % 1000;
+      }
+      rtc_units = wdt_slept_units;
+    #endif
+
+    #ifndef NO_MILLIS
+      uint32_t now = millis();
+      elapsed   += now - rtc_millis;
+      rtc_millis = now;
+    #endif
+
+    // Correct for the drift, in two halves so it does not overflow, carrying
+    //  the fraction of a mS so that frequent updates do not lose time
+    int32_t low = (int32_t)(elapsed & 0xFFFF) * rtc_drift + rtc_frac;
+    elapsed += (int32_t)(elapsed >> 16) * rtc_drift + (low >> 16);
+    rtc_frac = low & 0xFFFF;
+
+    rtc_ms      += elapsed % 1000;
+    rtc_seconds += elapsed / 1000 + rtc_ms / 1000;
+    rtc_ms      %= 1000;
+  }
+
+  /** Measure the WDT period (where we can) for counting the WDT periods slept from now on,
+   *   the time taken doing so (awake) is counted by millis().
+   */
+
+  static void rtc_calibrate()
+  {
+    #ifdef SS_HAS_WDT_MEASURE
+      rtc_t15 = wdt_measure_us(1);
+    #endif
+  }
+
+  /** How many mS to ask deeplyFor() for so that the clock will advance by sleepMs, the
+   *   reverse of the corrections rtc_update() makes.
+   */
+
+  static uint32_t rtc_nominal(uint32_t sleepMs)
+  {
+    uint32_t ms = ((uint64_t)sleepMs << 16) / (65536 + rtc_drift);
+
+    #ifdef SS_HAS_WDT_MEASURE
+      // Most of the time will be slept in the long periods (250mS and up), which are 16
+      //  units each, so 15625uS per unit nominally
+      if(rtc_t15)
+      {
+        ms = ((uint64_t)ms * 15625) / rtc_t15;
+      }
+    #endif
+
+    return ms ? ms : 1;
+  }
+
+  __attribute__((weak)) void SimpleSleep::setTime(uint32_t epoch)
+  {
+    rtc_update();
+    rtc_seconds = epoch;
+    rtc_ms      = 0;
+    rtc_frac    = 0;
+    rtc_synced  = epoch;
+    rtc_calibrate();
+  }
+
+  __attribute__((weak)) void SimpleSleep::syncTime(uint32_t epoch)
+  {
+    rtc_update();
+
+    // The error since the last sync, over a long enough time, is the drift
+    //  (which we were not already correcting for), a big error is more likely
+    //  a change of time than drift so it is ignored.
+    int32_t  error  = epoch - rtc_seconds;
+    uint32_t period = epoch - rtc_synced;
+    if(rtc_synced && period >= 600 && (uint32_t)abs(error) <= period / 8)
+    {
+      int64_t errorMs = (int64_t)error * 1000 - rtc_ms;
+      int32_t drift   = rtc_drift + (int32_t)((errorMs << 16) / ((int64_t)period * 1000));
+      rtc_drift = drift > 32767 ? 32767 : (drift < -32768 ? -32768 : drift);
+    }
+
+    rtc_seconds = epoch;
+    rtc_ms      = 0;
+    rtc_frac    = 0;
+    rtc_synced  = epoch;
+    rtc_calibrate();
+  }
+
+  __attribute__((weak)) uint32_t SimpleSleep::getTime()
+  {
+    rtc_update();
+    return rtc_seconds;
+  }
+
+  __attribute__((weak)) void SimpleSleep::untilTime(uint32_t epoch)
+  {
+    uint32_t now;
+    while((now = getTime()) < epoch)
+    {
+      // A day at a time so that the clock is updated at least that often
+      uint32_t sleepMs = epoch - now > 86400 ? 86400000UL : (epoch - now) * 1000 - rtc_ms;
+
+      // The WDT is never exact, until we are within a minute only sleep half the
+      //  time left and then look again, so that we close in rather than overshoot
+      if(sleepMs > 60000)
+      {
+        sleepMs /= 2;
+      }
+
+      deeplyFor(rtc_nominal(sleepMs));
+    }
+  }
+
+  __attribute__((weak)) void SimpleSleep::untilNext(uint8_t hours, uint8_t minutes)
+  {
+    uint32_t now    = getTime();
+    uint32_t target = now - (now % 86400) + (hours * 3600UL) + (minutes * 60UL);
+
+    if(target <= now)
+    {
+      target += 86400;
+    }
+
+    untilTime(target);
+  }
+
+#endif
@@ -62,12 +62,54 @@
     timed_sleep(sleepMs, SLEEP_MODE_IDLE, true, true);
   }
   
+  __attribute__((weak)) void SimpleSleep::sleepIdle(uint32_t sleepMs, SimpleSleep_Peripherals keep)
+  { 
+    // Like sleepDeeply(sleepMs) we need timer0 for the millis() part of a timed sleep
+    keep = keep | SS_KEEP_TIMER0;
+    
+    #ifdef SS_PRR
+      // The ADC must be disabled before it is powered down
+      uint8_t oldADCSRA = ADCSRA;
+      if(!(keep & SS_KEEP_ADC))
+      {
+        ADCSRA &= ~(1 << ADEN);
+      }
+      
+      uint8_t oldPRR = SS_PRR;
+      SS_PRR = oldPRR | (SS_KEEP_ALL & ~keep);
+    #else
+      (void)(keep); // Nothing can be powered down
+    #endif
+    
+    timed_sleep(sleepMs, SLEEP_MODE_IDLE, true, true);
+    
+    #ifdef SS_PRR
+      SS_PRR = oldPRR;
+      ADCSRA = oldADCSRA;
+    #endif
+  }
+  
+  uint32_t wdt_slept_ms = 0;
+  
+  #ifdef SS_HAS_WDT_MEASURE
+    uint32_t wdt_slept_units = 0;
+  #endif
+  
   #if  WDT_HAS_INTERRUPT == 1
     volatile uint8_t wdt_triggered = 1;
     
+  #endif
+  
+  #if WDT_HAS_INTERRUPT == 1
+  
     ISR (WDT_vect) 
     {
-      wdt_disable();  
+      // In interrupt and reset mode (wdt_enable() and WDIE) the next timeout would 
+      //  reset us, in interrupt only mode (avr-precise-sleep.cpp) it keeps running
+      if(WDTCSR & (1 << WDE))
+      {
+        wdt_disable();  
+      }
       wdt_triggered = 1;
     }
     
@@ -75,13 +117,29 @@
     {   
       do
       {
+        uint32_t requestedMs = sleepMs;
+        uint8_t  wdtPeriod   = SS_TRACE_NO_WDT;
+        
         // If we are not waiting on the WDT, and there is time still to sleep, setup the WDT (again)
         if (wdt_triggered && sleepMs)
         {
           wdt_triggered = 0;
-          wdt_enable(wdt_period_for(&sleepMs));
+          wdtPeriod = wdt_period_for(&sleepMs);
+          wdt_enable(wdtPeriod);
           WDTCSR |= (1 << WDIE);  
+          
+          // millis() does not count while Timer0 is stopped
+          if(mode != SLEEP_MODE_IDLE)
+          {
+            wdt_slept_ms += wdt_period_ms(wdtPeriod);
+            
+            #ifdef SS_HAS_WDT_MEASURE
+              wdt_slept_units += (uint16_t)1 << wdtPeriod;
+            #endif
+          }
         }
+        
+        ss_trace_sleep(mode, wdtPeriod, requestedMs);
       
         set_sleep_mode(mode);
         cli();        
@@ -104,6 +162,7 @@
         
         sleep_cpu();      
         sleep_disable();
+        ss_trace_wake(wdt_triggered ? SS_TRACE_WAKE_WDT : SS_TRACE_WAKE_OTHER);
         sei();
       } while(!wdt_triggered || sleepMs > 0);
     }
@@ -123,11 +182,13 @@
       do
       {
         // If we are not waiting on the WDT, and there is time still to sleep, setup the WDT (again)
-        if((millis() - startSleep)>=sleepMs)
+        uint32_t sleptMs = millis() - startSleep;
+        if(sleptMs >= sleepMs)
         {
           return;
         }
       
+        ss_trace_sleep(mode, SS_TRACE_NO_WDT, sleepMs - sleptMs);
         
         set_sleep_mode(mode);
         cli();        
@@ -150,6 +211,7 @@
         
         sleep_cpu();      
         sleep_disable();
+        ss_trace_wake(SS_TRACE_WAKE_OTHER);
         sei();
       } while(sleepMs > 0);
     
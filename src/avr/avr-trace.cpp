@@ -0,0 +1,83 @@
+/** This file contains the sleep/wake trace buffer and the methods for reading it back.
+ *
+ *  The events are recorded by ss_trace_sleep() and ss_trace_wake() (avr.h) which are
+ *  called from untimed_sleep() and timed_sleep(), tracing is only compiled in when
+ *  SS_TRACE is enabled.
+ */
+
+#if defined (__AVR__)
+
+  #include "../SimpleSleep.h"
+
+  #if SS_TRACE
+
+    SimpleSleep_TraceRecord ss_trace[SS_TRACE_SIZE];
+    uint8_t ss_trace_head = 0; // The next event to be written
+    uint8_t ss_trace_full = 0; // Set once the buffer has wrapped around
+    uint32_t ss_trace_woke = 0; // ss_trace_now() when we last woke up
+
+    /** Convert a recorded event, the timestamps are 24 bits of Timer0 ticks at F_CPU/64 */
+
+    static void trace_event(const SimpleSleep_TraceRecord &r, SimpleSleep_TraceEvent &e)
+    {
+      e.requestedMs = r.requestedMs;
+      e.mode        = r.mode;
+      e.wdtPeriod   = r.wdtPeriod;
+      e.wakeSource  = r.wakeSource;
+      e.awakeUs     = clockCyclesToMicroseconds((r.awakeTicks & 0xFFFFFFUL) * 64UL);
+    }
+
+    __attribute__((weak)) uint8_t SimpleSleep::getTrace(SimpleSleep_TraceEvent *events, uint8_t maxEvents)
+    {
+      uint8_t count = ss_trace_full ? SS_TRACE_SIZE : ss_trace_head;
+      if(count > maxEvents)
+      {
+        count = maxEvents;
+      }
+
+      // Oldest first, of the most recent count events
+      uint8_t i = ss_trace_head + SS_TRACE_SIZE - count;
+      for(uint8_t x = 0; x < count; x++, i++)
+      {
+        if(i >= SS_TRACE_SIZE)
+        {
+          i -= SS_TRACE_SIZE;
+        }
+        trace_event(ss_trace[i], events[x]);
+      }
+
+      return count;
+    }
+
+    __attribute__((weak)) void SimpleSleep::dumpTrace(Print &out)
+    {
+      SimpleSleep_TraceEvent e;
+
+      out.println(F("mode,wdt,wake,awakeUs,requestedMs"));
+
+      uint8_t count = ss_trace_full ? SS_TRACE_SIZE : ss_trace_head;
+      uint8_t i     = ss_trace_full ? ss_trace_head : 0;
+      while(count--)
+      {
+        trace_event(ss_trace[i], e);
+        if(++i == SS_TRACE_SIZE)
+        {
+          i = 0;
+        }
+
+        out.print(e.mode);        out.print(',');
+        out.print(e.wdtPeriod);   out.print(',');
+        out.print(e.wakeSource);  out.print(',');
+        out.print(e.awakeUs);     out.print(',');
+        out.println(e.requestedMs);
+      }
+    }
+
+    __attribute__((weak)) void SimpleSleep::clearTrace()
+    {
+      ss_trace_head = 0;
+      ss_trace_full = 0;
+    }
+
+  #endif
+#endif
@@ -20,8 +20,6 @@
   *  if necessary.
   */
 
-  
-  static void untimed_sleep(uint8_t mode, uint8_t bod, uint8_t interrupts);
 
   __attribute__((weak)) void SimpleSleep::sleepForever() 
   {
@@ -77,8 +75,35 @@
     untimed_sleep(SLEEP_MODE_IDLE, true, true);
   }
 
-  static void untimed_sleep(uint8_t mode, uint8_t bod, uint8_t interrupts)
+  __attribute__((weak)) void SimpleSleep::sleepIdle(SimpleSleep_Peripherals keep)
+  {
+    #ifdef SS_PRR
+      // The ADC must be disabled before it is powered down
+      uint8_t oldADCSRA = ADCSRA;
+      if(!(keep & SS_KEEP_ADC))
+      {
+        ADCSRA &= ~(1 << ADEN);
+      }
+      
+      uint8_t oldPRR = SS_PRR;
+      SS_PRR = oldPRR | (SS_KEEP_ALL & ~keep);
+    #else
+      (void)(keep); // Nothing can be powered down
+    #endif
+    
+    // sleep with bod on, interrupts on
+    untimed_sleep(SLEEP_MODE_IDLE, true, true);
+    
+    #ifdef SS_PRR
+      SS_PRR = oldPRR;
+      ADCSRA = oldADCSRA;
+    #endif
+  }
+
+  void untimed_sleep(uint8_t mode, uint8_t bod, uint8_t interrupts)
   {
+    ss_trace_sleep(mode, SS_TRACE_NO_WDT, 0);
+    
     set_sleep_mode(mode);
     cli();        
     sleep_enable();
@@ -101,6 +126,7 @@
 
     sleep_cpu();      
     sleep_disable();
+    ss_trace_wake(SS_TRACE_WAKE_OTHER);
     sei();
   }
   
@@ -25,6 +25,21 @@
   #error "SimpleSleep does not support this microcontroller."
 #endif
 
+/** Combine SS_KEEP_... peripherals, eg `SS_KEEP_USART0 | SS_KEEP_TIMER0` */
+
+inline SimpleSleep_Peripherals operator|(SimpleSleep_Peripherals a, SimpleSleep_Peripherals b)
+{
+  return (SimpleSleep_Peripherals)((uint8_t)a | (uint8_t)b);
+}
+
+/** The Power Reduction Register which holds the SS_KEEP_... bits, if any. */
+
+#if defined(PRR)
+  #define SS_PRR PRR
+#elif defined(PRR0)
+  #define SS_PRR PRR0
+#endif
+
 /** Determine if to use the integer type of calibration, or a floating.
  * 
  * Undefine the below to use floating, which may be more accurate, but heavier weight.
@@ -34,15 +49,7 @@
   #define SS_USE_INT_CAL 1
 #endif
 
-#ifdef NO_MILLIS
-
-    /* If millis is not available, then we can not really do calibration,
-     *  the calibration will always just return 1
-     */
-    
-   typedef uint8_t SimpleSleep_Cal;
-   
-#elif SS_USE_INT_CAL == 1
+#if SS_USE_INT_CAL == 1
 
 /** The WDT on AVR generally has two ranges, 
  *     15ms->120ms and 250ms->8000ms (some, 2000ms)
@@ -50,6 +57,9 @@
  *  millis() reported then we can add/subtract appropriately in the 
  *  calibrated versions of deeply/lightly/idle
  * 
+ *  Without millis (NO_MILLIS) we instead count 1mS spin-loops until the
+ *  WDT fires, which gives the same offsets.
+ * 
  *  Note that we are using a signed byte here for each calibration,
  *  this *should* be ok, the WDT would have to be like 50% out to
  *  cause a problem there and that is, I hope, unlikely.
@@ -69,6 +79,137 @@ struct SimpleSleep_Cal
 typedef float SimpleSleep_Cal;
 #endif
 
+/** Sleep/wake tracing, when enabled every sleep is recorded in a small RAM ring
+ *   buffer which can be read back with SimpleSleep::getTrace() or dumpTrace().
+ * 
+ *  Define SS_TRACE as 1 (here or in your build flags) to enable, each event
+ *   costs 11 bytes of RAM so keep SS_TRACE_SIZE small on the little chips.
+ * 
+ *  The time awake between sleeps is taken from Timer0 as the core's millis() runs
+ *   it (/64, counting overflows in SS_TRACE_OVERFLOWS), so it is not recorded 
+ *   (always 0) when millis() is disabled (NO_MILLIS), and wraps after 2^24 Timer0
+ *   ticks (67 seconds at 16MHz).
+ */
+
+#ifndef SS_TRACE
+  #define SS_TRACE 0
+#endif
+
+#ifndef SS_TRACE_SIZE
+  #define SS_TRACE_SIZE 8   // Up to 127
+#endif
+
+/** The Timer0 overflow count kept by the core for millis(), this is the Arduino AVR
+ *   core's, define SS_TRACE_OVERFLOWS as your core's equivalent if it differs.
+ */
+
+#ifndef SS_TRACE_OVERFLOWS
+  #define SS_TRACE_OVERFLOWS timer0_overflow_count
+#endif
+
+#define SS_TRACE_NO_WDT     0xFF  // No WDT period was started for this sleep
+#define SS_TRACE_WAKE_OTHER 0     // Woken by something other than the WDT
+#define SS_TRACE_WAKE_WDT   1     // Woken by the WDT
+
+/** One sleep as recorded in the trace. */
+
+struct SimpleSleep_TraceEvent
+{
+  uint32_t requestedMs; // Time still to sleep when this sleep started, 0 if untimed
+  uint8_t  mode;        // SLEEP_MODE_...
+  uint8_t  wdtPeriod;   // WDTO_... started for this sleep, or SS_TRACE_NO_WDT
+  uint8_t  wakeSource;  // SS_TRACE_WAKE_...
+  uint32_t awakeUs;     // uS spent awake before this sleep (since the last wake)
+};
+
+/** One sleep as it is kept in the buffer, the time awake is in raw Timer0 ticks 
+ *   (ss_trace_now()) so that getTrace()/dumpTrace() do the conversion, not the
+ *   sleep and wake.
+ */
+
+struct SimpleSleep_TraceRecord
+{
+  uint32_t requestedMs;
+  uint8_t  mode;
+  uint8_t  wdtPeriod;
+  uint8_t  wakeSource;
+  uint32_t awakeTicks;
+};
+
+#if SS_TRACE
+  extern SimpleSleep_TraceRecord ss_trace[SS_TRACE_SIZE];
+  extern uint8_t ss_trace_head;
+  extern uint8_t ss_trace_full;
+  extern uint32_t ss_trace_woke;
+  
+  #ifndef NO_MILLIS
+    extern "C" volatile unsigned long SS_TRACE_OVERFLOWS;
+  #endif
+#endif
+
+/** A raw timestamp for the trace, the low 16 bits of the Timer0 overflow count and
+ *   TCNT0, in Timer0 ticks.  Cheaper than micros(), which does the same and then 
+ *   converts it, 0 if there is no millis().
+ */
+
+inline uint32_t ss_trace_now()
+{
+  #if SS_TRACE && !defined(NO_MILLIS)
+    uint8_t oldSREG = SREG;
+    cli();
+    uint8_t  t = TCNT0;
+    uint16_t o = (uint16_t)SS_TRACE_OVERFLOWS;
+    
+    // An overflow which its interrupt has not counted yet
+    #ifdef TIFR0
+      if((TIFR0 & _BV(TOV0)) && t < 255) o++;
+    #else
+      if((TIFR & _BV(TOV0)) && t < 255) o++;
+    #endif
+    
+    SREG = oldSREG;
+    return ((uint32_t)o << 8) | t;
+  #else
+    return 0;
+  #endif
+}
+
+/** Record the start of a sleep in the trace (if enabled), call immediately before
+ *   going to sleep.
+ */
+
+inline void ss_trace_sleep(uint8_t mode, uint8_t wdtPeriod, uint32_t requestedMs)
+{
+  #if SS_TRACE
+    SimpleSleep_TraceRecord *e = &ss_trace[ss_trace_head];
+    e->requestedMs = requestedMs;
+    e->mode        = mode;
+    e->wdtPeriod   = wdtPeriod;
+    e->awakeTicks  = ss_trace_now() - ss_trace_woke;
+  #else
+    (void)(mode); (void)(wdtPeriod); (void)(requestedMs); // Silence warning
+  #endif
+}
+
+/** Record the end of a sleep in the trace (if enabled), call immediately after
+ *   waking up.
+ */
+
+inline void ss_trace_wake(uint8_t wakeSource)
+{
+  #if SS_TRACE
+    ss_trace_woke = ss_trace_now();
+    ss_trace[ss_trace_head].wakeSource = wakeSource;
+    if(++ss_trace_head == SS_TRACE_SIZE)
+    {
+      ss_trace_head = 0;
+      ss_trace_full = 1;
+    }
+  #else
+    (void)(wakeSource); // Silence warning
+  #endif
+}
+
 /** Most chips have a watchdog interrupt, but some do not. */
 #ifndef WDT_HAS_INTERRUPT
   #if !defined(WDIE) && !defined(WDTIE)
@@ -78,16 +219,76 @@ typedef float SimpleSleep_Cal;
   #endif
 #endif
 
+#if WDT_HAS_INTERRUPT == 1
+  /** Set by the WDT interrupt (avr-timed-sleep.cpp) when the watchdog period
+   *   has expired, it sits at 1 while the WDT is not in use.
+   */
+  
+  extern volatile uint8_t wdt_triggered;
+#endif
+
+/** Sleep once in the given mode (SLEEP_MODE_...), optionally with the BOD off
+ *   and interrupts disabled, see avr-untimed-sleep.cpp
+ */
+
+void untimed_sleep(uint8_t mode, uint8_t bod, uint8_t interrupts);
+
+/** Where there is a 16 bit Timer1, the WDT can be timed against it to the microsecond,
+ *   see SimpleSleep::getFastCalibration()
+ */
+
+#if defined(TCNT1H) && defined(TIMSK1) && WDT_HAS_INTERRUPT == 1
+  #define SS_HAS_WDT_MEASURE 1
+  
+  /** Time the given number of 15mS WDT periods with Timer1, returns the total in uS.
+   *  
+   *  The chip is awake for that time, Timer1 is put back as it was afterwards.
+   */
+  
+  uint32_t wdt_measure_us(uint8_t periods);
+  
+  /** SimpleSleep::preciselyFor() uses no interrupt of its own unless SS_PRECISE_ISR 
+   *   is 1 (here or in your build flags), in which case it defines TIMER1_COMPA_vect, 
+   *   so can not be used with Servo, TimerOne or anything else using that, in return
+   *   it spends less time awake in its last 1mS or so.
+   */
+  
+  #ifndef SS_PRECISE_ISR
+    #define SS_PRECISE_ISR 0
+  #endif
+#endif
+
+/** Total mS slept in WDT periods while Timer0 was stopped (that is, not idle), 
+ *   added to millis() this is how much time has passed, see SimpleSleep::getTime()
+ */
+
+extern uint32_t wdt_slept_ms;
+
+#ifdef SS_HAS_WDT_MEASURE
+  /** The same WDT periods counted in units of the shortest period (2K WDT cycles, 
+   *   nominally 15mS, a 250mS period is 16 of them), times the measured length 
+   *   of one unit this is how long was actually slept, see SimpleSleep::getTime()
+   */
+  
+  extern uint32_t wdt_slept_units;
+#endif
+
+/** The nominal length in mS of a WDT period (WDTO_...) */
+
+inline uint16_t wdt_period_ms(uint8_t wdtPeriod)
+{
+  // 15, 30, 60, 120 and then 250, 500 ... 8000
+  return wdtPeriod < WDTO_250MS ? (15 << wdtPeriod) : (250 << (wdtPeriod - WDTO_250MS));
+}
+
 /** Determine the WDT period (avr/wdt.h) which is necessary to sleep for next
- *   in order to get closer tot he sleepMs, also deduct that many mS from sleepMs
- *  
- * This is defined here in the header so that it is inlined since it's most likely
- *   to only be used in one place by each variant (and there will only be one 
- *   variant active), so the overhead of calling it as an extern, with LTO off 
- *   at least, is substantial.
+ *   in order to get closer to the sleepMs, also deduct that many mS from sleepMs
+ *   
+ *  Once less than 30mS remain, 15mS (the minimum) is used and sleepMs is zeroed,
+ *   no spin-wait is done here so this is safe to use from the WDT interrupt.
  */
 
-inline uint16_t wdt_period_for(uint32_t *sleepMs)
+inline uint8_t wdt_period_next(uint32_t *sleepMs)
 {
   #ifdef WDP3
     //  8000, 4000, 2000, 1000, 500, 250, and then 120, 60, 30, 15
@@ -118,18 +319,32 @@ inline uint16_t wdt_period_for(uint32_t *sleepMs)
     }
   }
   
-  // The sleep time is less than 30mS (x == 1),  if it's greater than 15mS, 
+  *sleepMs = 0;
+  return WDTO_15MS;
+}
+
+/** Determine the WDT period (avr/wdt.h) which is necessary to sleep for next
+ *   in order to get closer tot he sleepMs, also deduct that many mS from sleepMs
+ *  
+ * This is defined here in the header so that it is inlined since it's most likely
+ *   to only be used in one place by each variant (and there will only be one 
+ *   variant active), so the overhead of calling it as an extern, with LTO off 
+ *   at least, is substantial.
+ */
+
+inline uint16_t wdt_period_for(uint32_t *sleepMs)
+{
+  // The sleep time is less than 30mS,  if it's greater than 15mS, 
   //  spin-wait until it's 15mS then allow the WDT to do the rest, if it's less 
   //  than 15mS then 15mS it is, that is the minimum we can sleep for and we
   //  MUST sleep.
   
-  if(*sleepMs > 15)
+  if(*sleepMs < 30 && *sleepMs > 15)
   {
     delay(*sleepMs - 15);
   }
   
-  *sleepMs = 0;
-  return WDTO_15MS;
+  return wdt_period_next(sleepMs);
 }
 
 /** Macro for declaring backup variables for all the Power Reduction Register
@@ -224,7 +439,7 @@ inline uint16_t wdt_period_for(uint32_t *sleepMs)
 #ifdef PRR0
   #define power_declare_prr0(...)  __VA_ARGS__ uint8_t oldPRR0;
   #define power_save_prr0()      oldPRR0 = PRR0;
-  #define power_restore_prr0()   PRR = oldPRR0;
+  #define power_restore_prr0()   PRR0 = oldPRR0;
 #else
   #define power_declare_prr0(...)
   #define power_save_prr0()      
@@ -234,7 +449,7 @@ inline uint16_t wdt_period_for(uint32_t *sleepMs)
 #ifdef PRR1
   #define power_declare_prr1(...)  __VA_ARGS__ uint8_t oldPRR1;
   #define power_save_prr1()      oldPRR1 = PRR1;
-  #define power_restore_prr1()   PRR = oldPRR1;
+  #define power_restore_prr1()   PRR1 = oldPRR1;
 #else
   #define power_declare_prr1(...)
   #define power_save_prr1()      
@@ -244,7 +459,7 @@ inline uint16_t wdt_period_for(uint32_t *sleepMs)
 #ifdef PRR2
   #define power_declare_prr2(...)  __VA_ARGS__ uint8_t oldPRR2;
   #define power_save_prr2()      oldPRR2 = PRR2;
-  #define power_restore_prr2()   PRR = oldPRR2;
+  #define power_restore_prr2()   PRR2 = oldPRR2;
 #else
   #define power_declare_prr2(...)
   #define power_save_prr2()      